@@ -0,0 +1,512 @@
+// asset_cooker.c
+// Offline cooker for the images[] list. Each PNG is decoded, trimmed,
+// mipmapped, premultiplied and optionally block compressed once and the result
+// kept in a per-image cache file, so a rerun only touches images whose source
+// changed. The cache is then assembled into a texture pack, with byte-identical
+// results stored once.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define makeDir(path) _mkdir(path)
+#else
+#define makeDir(path) mkdir(path, 0755)
+#endif
+
+#include <SDL3/SDL.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "image_paths.h"
+#include "image_ops.h"
+#include "block_compress.h"
+#include "texture_pack.h"
+#include "image_manifest.h"
+
+#define COOK_MAGIC   0x4B4F4F43u // "COOK"
+#define COOK_VERSION 3u
+
+enum {
+    COOK_PREMULTIPLY = 1u << 0,
+    COOK_TRIM        = 1u << 1,
+    COOK_MIPS        = 1u << 2,
+    COOK_GAMMA_MIPS  = 1u << 3, // filter mips in linear light with alpha weighting, else a plain box
+    COOK_BC3         = 1u << 4,
+    COOK_BC7         = 1u << 5,
+    COOK_DESCRIBE    = 1u << 6, // --manifest-only, cache files hold just the header
+};
+
+// per-image cache file: this header followed by entry.size bytes of cooked pixels
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t settings;
+    uint32_t psnr; // level 0 after block compression in 1/100 dB, UINT32_MAX when lossless
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint64_t hash; // of the cooked pixels, for deduplication
+    packEntry entry; // pathHash and offset are left for the pack writer
+    manifestEntry manifest; // of the source image
+} cookHeader;
+
+typedef struct {
+    bool ok;
+    bool rebuilt;
+    cookHeader header;
+} cookResult;
+
+typedef struct {
+    const char* root;
+    const char* cacheDir;
+    uint32_t settings;
+    bool force;
+
+    SDL_AtomicInt next;
+    cookResult* results;
+} cookContext;
+
+static void sourcePath(char* out, const size_t outc, const cookContext* ctx, const size_t index) {
+    snprintf(out, outc, "%s/%s", ctx->root, images[index]);
+}
+
+static void cachePath(char* out, const size_t outc, const cookContext* ctx, const size_t index) {
+    snprintf(out, outc, "%s/%016llx.cook", ctx->cacheDir, (unsigned long long)texturePackHashPath(images[index]));
+}
+
+static bool readCacheHeader(const char* path, cookHeader* header) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    const bool ok = fread(header, sizeof(cookHeader), 1, f) == 1;
+    fclose(f);
+    return ok && header->magic == COOK_MAGIC && header->version == COOK_VERSION;
+}
+
+static bool writeCacheFile(const char* path, const cookHeader* header, const void* data) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE* f = fopen(tmp, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(header, sizeof(cookHeader), 1, f) == 1;
+    ok = ok && (header->entry.size == 0 || fwrite(data, 1, header->entry.size, f) == header->entry.size);
+    ok = fclose(f) == 0 && ok;
+
+    remove(path);
+    return ok && rename(tmp, path) == 0;
+}
+
+static bool cookImage(const cookContext* ctx, const size_t index, cookResult* result) {
+    char src[1024], cache[1024];
+    sourcePath(src, sizeof(src), ctx, index);
+    cachePath(cache, sizeof(cache), ctx, index);
+
+    struct stat st;
+    if (stat(src, &st) != 0) {
+        fprintf(stderr, "Missing source '%s'\n", src);
+        return false;
+    }
+
+    cookHeader* header = &result->header;
+    if (!ctx->force && readCacheHeader(cache, header) && header->settings == ctx->settings &&
+        header->sourceMtime == (int64_t)st.st_mtime && header->sourceSize == (uint64_t)st.st_size)
+        return true;
+
+    int w, h, n;
+    unsigned char* pixels = stbi_load(src, &w, &h, &n, 4);
+    if (!pixels) {
+        fprintf(stderr, "Failed to load '%s': %s\n", src, stbi_failure_reason());
+        return false;
+    }
+
+    manifestEntry manifest;
+    imageManifestDescribe(pixels, w, h, &manifest);
+    manifest.pathHash = texturePackHashPath(images[index]);
+    manifest.sourceMtime = (int64_t)st.st_mtime;
+    manifest.sourceSize = (uint64_t)st.st_size;
+
+    if (ctx->settings & COOK_DESCRIBE) {
+        stbi_image_free(pixels);
+        *header = (cookHeader){
+            .magic = COOK_MAGIC,
+            .version = COOK_VERSION,
+            .settings = ctx->settings,
+            .sourceMtime = (int64_t)st.st_mtime,
+            .sourceSize = (uint64_t)st.st_size,
+            .manifest = manifest,
+        };
+        result->rebuilt = writeCacheFile(cache, header, nullptr);
+        return result->rebuilt;
+    }
+
+    int x = 0, y = 0, tw = w, th = h;
+    if (ctx->settings & COOK_TRIM)
+        imageTrimBounds(pixels, w, h, &x, &y, &tw, &th);
+
+    const int levels = ctx->settings & COOK_MIPS ? imageMipCount(tw, th) : 1;
+    size_t size = imageMipChainSize(tw, th, levels);
+    unsigned char* cooked = malloc(size);
+
+    // level 0 is the trimmed rect, every further level is filtered from the one before
+    for (int row = 0; row < th; ++row)
+        memcpy(cooked + (size_t)row * tw * 4, pixels + ((size_t)(y + row) * w + x) * 4, (size_t)tw * 4);
+    stbi_image_free(pixels);
+
+    unsigned char* level = cooked;
+    int lw = tw, lh = th;
+    for (int i = 1; i < levels; ++i) {
+        unsigned char* nextLevel = level + (size_t)lw * lh * 4;
+        if (ctx->settings & COOK_GAMMA_MIPS)
+            imageDownsampleSRGB(level, lw, lh, nextLevel);
+        else
+            imageDownsample(level, lw, lh, nextLevel);
+        level = nextLevel;
+        lw = lw > 1 ? lw / 2 : 1;
+        lh = lh > 1 ? lh / 2 : 1;
+    }
+
+    // filtering wants straight alpha, so the whole chain is premultiplied last
+    if (ctx->settings & COOK_PREMULTIPLY)
+        imagePremultiply(cooked, size / 4);
+
+    // blocks are encoded from exactly what would have been uploaded, level by level
+    uint32_t format = PACK_FORMAT_RGBA8, psnr = UINT32_MAX;
+    if (ctx->settings & (COOK_BC3 | COOK_BC7)) {
+        const bool bc7 = ctx->settings & COOK_BC7;
+        format = bc7 ? PACK_FORMAT_BC7 : PACK_FORMAT_BC3;
+        const pixelLayout layout = packFormatLayout(format);
+        const size_t compressedSize = pixelLayoutChainSize(layout, tw, th, levels);
+        unsigned char* blocks = malloc(compressedSize);
+
+        const unsigned char* texels = cooked;
+        unsigned char* dst = blocks;
+        lw = tw;
+        lh = th;
+        for (int i = 0; i < levels; ++i) {
+            if (bc7)
+                blockEncodeBC7(texels, lw, lh, dst);
+            else
+                blockEncodeBC3(texels, lw, lh, dst);
+            texels += (size_t)lw * lh * 4;
+            dst += pixelLayoutLevelSize(layout, lw, lh);
+            lw = lw > 1 ? lw / 2 : 1;
+            lh = lh > 1 ? lh / 2 : 1;
+        }
+
+        // decoding level 0 again is what the GPU will sample, so that is what gets scored
+        unsigned char* decoded = malloc((size_t)tw * th * 4);
+        bool decodable = true;
+        if (bc7)
+            decodable = blockDecodeBC7(blocks, tw, th, decoded);
+        else
+            blockDecodeBC3(blocks, tw, th, decoded);
+        if (!decodable) {
+            // the encoder only writes modes 5 and 6, anything else is a bug there
+            fprintf(stderr, "BC7 blocks of '%s' use a mode the decoder doesn't know\n", src);
+            free(decoded);
+            free(blocks);
+            free(cooked);
+            return false;
+        }
+        const double db = imagePSNR(cooked, decoded, (size_t)tw * th);
+        psnr = isinf(db) ? UINT32_MAX : (uint32_t)(db * 100.0 + 0.5);
+        free(decoded);
+
+        free(cooked);
+        cooked = blocks;
+        size = compressedSize;
+    }
+
+    *header = (cookHeader){
+        .magic = COOK_MAGIC,
+        .version = COOK_VERSION,
+        .settings = ctx->settings,
+        .psnr = psnr,
+        .sourceMtime = (int64_t)st.st_mtime,
+        .sourceSize = (uint64_t)st.st_size,
+        .hash = imageHash(cooked, size),
+        .entry = {
+            .size = size,
+            .width = (uint32_t)tw, .height = (uint32_t)th,
+            .format = format,
+            .levels = (uint32_t)levels,
+            .sourceWidth = (uint32_t)w, .sourceHeight = (uint32_t)h,
+            .trimX = (uint32_t)x, .trimY = (uint32_t)y,
+        },
+        .manifest = manifest,
+    };
+
+    const bool ok = writeCacheFile(cache, header, cooked);
+    if (!ok)
+        fprintf(stderr, "Failed to write '%s'\n", cache);
+    free(cooked);
+
+    result->rebuilt = ok;
+    return ok;
+}
+
+static int cookWorker(void* data) {
+    cookContext* ctx = data;
+    for (;;) {
+        const size_t index = (size_t)SDL_AddAtomicInt(&ctx->next, 1);
+        if (index >= suki_sprites)
+            break;
+        ctx->results[index].ok = cookImage(ctx, index, &ctx->results[index]);
+    }
+    return 0;
+}
+
+// an existing pack can be kept when nothing was recooked and it lists the same images in the same order
+static bool packUpToDate(const char* outPath, const uint32_t flags) {
+    struct stat st;
+    if (stat(outPath, &st) != 0)
+        return false;
+
+    texturePack* pack = texturePackOpen(outPath);
+    if (!pack)
+        return false;
+
+    bool same = texturePackCount(pack) == suki_sprites && texturePackFlags(pack) == flags;
+    for (size_t i = 0; same && i < suki_sprites; ++i)
+        same = texturePackEntry(pack, i)->pathHash == texturePackHashPath(images[i]);
+
+    texturePackClose(pack);
+    return same;
+}
+
+// the cooked blob of image index, read from its cache file into *buffer (grown to fit)
+static bool readCookedBlob(const cookContext* ctx, const size_t index, void** buffer, size_t* bufferc) {
+    const cookHeader* header = &ctx->results[index].header;
+    char cache[1024];
+    cachePath(cache, sizeof(cache), ctx, index);
+    FILE* f = fopen(cache, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open '%s'\n", cache);
+        return false;
+    }
+    if (*bufferc < header->entry.size) {
+        *bufferc = header->entry.size;
+        *buffer = realloc(*buffer, *bufferc);
+    }
+    const bool ok = fseek(f, sizeof(cookHeader), SEEK_SET) == 0 && fread(*buffer, 1, header->entry.size, f) == header->entry.size;
+    fclose(f);
+    return ok;
+}
+
+static bool assemblePack(const cookContext* ctx, const char* outPath, const bool dedup) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", outPath);
+
+    const uint32_t flags = ctx->settings & COOK_PREMULTIPLY ? PACK_FLAG_PREMULTIPLIED : 0;
+    texturePackWriter* writer = texturePackWriterCreate(tmp, suki_sprites, flags);
+    if (!writer)
+        return false;
+
+    size_t duplicates = 0;
+    uint64_t rawBytes = 0, packedBytes = 0;
+    void *buffer = nullptr, *other = nullptr;
+    size_t bufferc = 0, otherc = 0;
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < suki_sprites; ++i) {
+        const cookHeader* header = &ctx->results[i].header;
+        rawBytes += (uint64_t)header->entry.sourceWidth * header->entry.sourceHeight * 4;
+        if (!readCookedBlob(ctx, i, &buffer, &bufferc)) {
+            ok = false;
+            break;
+        }
+
+        // the hash only picks candidates, the blobs are compared before aliasing. the earliest
+        // identical blob is never an alias itself, so it is the one that got written
+        size_t shared = i;
+        for (size_t j = 0; dedup && ok && j < i && shared == i; ++j) {
+            const cookHeader* candidate = &ctx->results[j].header;
+            if (candidate->hash != header->hash || candidate->entry.size != header->entry.size ||
+                candidate->entry.width != header->entry.width || candidate->entry.height != header->entry.height ||
+                candidate->entry.levels != header->entry.levels)
+                continue;
+            if (otherc < header->entry.size) {
+                otherc = header->entry.size;
+                other = realloc(other, otherc);
+            }
+            // j is already in the pack, aliased or not, so it is read back from there
+            ok = texturePackWriterRead(writer, j, other);
+            if (ok && memcmp(other, buffer, header->entry.size) == 0)
+                shared = j;
+        }
+        if (!ok)
+            break;
+        if (shared != i) {
+            ok = texturePackWriterAlias(writer, i, images[i], &header->entry, shared);
+            duplicates++;
+            continue;
+        }
+
+        ok = texturePackWriterAdd(writer, i, images[i], &header->entry, buffer);
+        packedBytes += header->entry.size;
+    }
+    free(buffer);
+    free(other);
+    ok = texturePackWriterFinish(writer) && ok;
+
+    if (ok) {
+        remove(outPath);
+        ok = rename(tmp, outPath) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write texture pack '%s'\n", outPath);
+        remove(tmp);
+        return false;
+    }
+
+    printf("Wrote '%s': %zu images, %zu duplicates, %.1f MiB of pixels (%.1f MiB decoded source)\n",
+           outPath, suki_sprites, duplicates, packedBytes / (1024.0 * 1024.0), rawBytes / (1024.0 * 1024.0));
+    return true;
+}
+
+// block compression quality from the cache headers, so up to date images count too
+static void reportCompression(const cookContext* ctx) {
+    double sum = 0.0;
+    size_t scored = 0, lossless = 0, worst = SIZE_MAX;
+    for (size_t i = 0; i < suki_sprites; ++i) {
+        const uint32_t psnr = ctx->results[i].header.psnr;
+        if (psnr == UINT32_MAX) {
+            lossless++;
+            continue;
+        }
+        sum += psnr / 100.0;
+        scored++;
+        if (worst == SIZE_MAX || psnr < ctx->results[worst].header.psnr)
+            worst = i;
+    }
+    printf("%s: %zu lossless", ctx->settings & COOK_BC7 ? "BC7" : "BC3", lossless);
+    if (scored)
+        printf(", average PSNR %.2f dB, worst %.2f dB ('%s')", sum / (double)scored,
+               ctx->results[worst].header.psnr / 100.0, images[worst]);
+    printf("\n");
+}
+
+// every image's manifest entry, straight from the cache headers
+static bool writeManifest(const cookContext* ctx, const char* path) {
+    manifestEntry* entries = malloc(sizeof(manifestEntry) * suki_sprites);
+    for (size_t i = 0; i < suki_sprites; ++i)
+        entries[i] = ctx->results[i].header.manifest;
+    const bool ok = imageManifestWrite(path, entries, suki_sprites);
+    free(entries);
+
+    if (ok)
+        printf("Wrote manifest '%s'\n", path);
+    else
+        fprintf(stderr, "Failed to write manifest '%s'\n", path);
+    return ok;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--root DIR] [--out FILE] [--cache DIR] [-j THREADS]\n"
+            "          [--no-premultiply] [--no-trim] [--no-mips] [--box-mips] [--compress none|bc3|bc7]\n"
+            "          [--no-dedup] [--force] [--manifest FILE] [--manifest-only]\n", argv0);
+}
+
+int main(const int argc, char** argv) {
+    cookContext ctx = {
+        .root = ".",
+        .cacheDir = "cooked",
+        .settings = COOK_PREMULTIPLY | COOK_TRIM | COOK_MIPS | COOK_GAMMA_MIPS,
+    };
+    const char* outPath = "assets.pack";
+    const char* manifestPath = nullptr;
+    bool dedup = true;
+    int threadCount = SDL_GetNumLogicalCPUCores();
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+            ctx.root = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            ctx.cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-premultiply") == 0) {
+            ctx.settings &= ~COOK_PREMULTIPLY;
+        } else if (strcmp(argv[i], "--no-trim") == 0) {
+            ctx.settings &= ~COOK_TRIM;
+        } else if (strcmp(argv[i], "--no-mips") == 0) {
+            ctx.settings &= ~COOK_MIPS;
+        } else if (strcmp(argv[i], "--box-mips") == 0) {
+            ctx.settings &= ~COOK_GAMMA_MIPS;
+        } else if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            ctx.settings &= ~(COOK_BC3 | COOK_BC7);
+            if (strcmp(mode, "bc3") == 0) {
+                ctx.settings |= COOK_BC3;
+            } else if (strcmp(mode, "bc7") == 0) {
+                ctx.settings |= COOK_BC7;
+            } else if (strcmp(mode, "none") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--no-dedup") == 0) {
+            dedup = false;
+        } else if (strcmp(argv[i], "--force") == 0) {
+            ctx.force = true;
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            manifestPath = argv[++i];
+        } else if (strcmp(argv[i], "--manifest-only") == 0) {
+            ctx.settings |= COOK_DESCRIBE;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (threadCount < 1)
+        threadCount = 1;
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    makeDir(ctx.cacheDir);
+    ctx.results = calloc(suki_sprites, sizeof(cookResult));
+
+    SDL_Thread** threads = malloc(sizeof(SDL_Thread*) * threadCount);
+    for (int i = 0; i < threadCount; ++i)
+        threads[i] = SDL_CreateThread(cookWorker, "cook", &ctx);
+    for (int i = 0; i < threadCount; ++i) {
+        if (threads[i])
+            SDL_WaitThread(threads[i], nullptr);
+    }
+    free(threads);
+    // a thread that failed to start leaves its share for us
+    cookWorker(&ctx);
+
+    size_t rebuilt = 0, failed = 0;
+    for (size_t i = 0; i < suki_sprites; ++i) {
+        rebuilt += ctx.results[i].rebuilt;
+        failed += !ctx.results[i].ok;
+    }
+    printf("Cooked %zu of %zu images (%zu up to date, %zu failed)\n",
+           rebuilt, suki_sprites, suki_sprites - rebuilt - failed, failed);
+    if (ctx.settings & (COOK_BC3 | COOK_BC7) && !(ctx.settings & COOK_DESCRIBE) && failed == 0)
+        reportCompression(&ctx);
+
+    const uint32_t flags = ctx.settings & COOK_PREMULTIPLY ? PACK_FLAG_PREMULTIPLIED : 0;
+    bool ok = failed == 0;
+    // with --manifest-only no pixels were cooked, so there is no pack to write
+    const bool writePack = !(ctx.settings & COOK_DESCRIBE);
+    if (ok && writePack && (rebuilt > 0 || !dedup || !packUpToDate(outPath, flags)))
+        ok = assemblePack(&ctx, outPath, dedup);
+    else if (ok && writePack)
+        printf("'%s' is up to date\n", outPath);
+    if (ok && manifestPath)
+        ok = writeManifest(&ctx, manifestPath);
+
+    const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    printf("Cooking took %.2f ms\n", ms);
+
+    free(ctx.results);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+// atlas.c
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "atlas.h"
+
+typedef struct {
+    int x, y, width;
+} skylineNode;
+
+typedef struct {
+    skylineNode* nodes;
+    size_t nodec, nodeCap;
+    int size;
+} skylinePage;
+
+static void skylineInit(skylinePage* page, const int size) {
+    page->nodeCap = 16;
+    page->nodes = malloc(sizeof(skylineNode) * page->nodeCap);
+    page->nodes[0] = (skylineNode){ 0, 0, size };
+    page->nodec = 1;
+    page->size = size;
+}
+
+// height the rect would rest at when its left edge sits on node i, -1 if it does not fit
+static int skylineFit(const skylinePage* page, size_t i, const int w, const int h) {
+    const int x = page->nodes[i].x;
+    if (x + w > page->size)
+        return -1;
+
+    int y = 0;
+    for (int left = w; left > 0; left -= page->nodes[i++].width) {
+        if (page->nodes[i].y > y)
+            y = page->nodes[i].y;
+        if (y + h > page->size)
+            return -1;
+    }
+    return y;
+}
+
+// bottom-left placement: lowest top edge wins, ties go to the narrowest node
+static bool skylineInsert(skylinePage* page, const int w, const int h, int* outX, int* outY) {
+    size_t best = SIZE_MAX;
+    int bestY = 0, bestTop = page->size + 1, bestWidth = 0;
+
+    for (size_t i = 0; i < page->nodec; ++i) {
+        const int y = skylineFit(page, i, w, h);
+        if (y < 0)
+            continue;
+        if (y + h < bestTop || (y + h == bestTop && page->nodes[i].width < bestWidth)) {
+            best = i;
+            bestY = y;
+            bestTop = y + h;
+            bestWidth = page->nodes[i].width;
+        }
+    }
+    if (best == SIZE_MAX)
+        return false;
+
+    *outX = page->nodes[best].x;
+    *outY = bestY;
+
+    // new node covers the rect's top edge, the ones it shadows are cut back or dropped
+    if (page->nodec == page->nodeCap) {
+        page->nodeCap *= 2;
+        page->nodes = realloc(page->nodes, sizeof(skylineNode) * page->nodeCap);
+    }
+    for (size_t i = page->nodec; i > best; --i)
+        page->nodes[i] = page->nodes[i - 1];
+    page->nodes[best] = (skylineNode){ *outX, bestY + h, w };
+    page->nodec++;
+
+    for (size_t i = best + 1; i < page->nodec;) {
+        skylineNode* prev = &page->nodes[i - 1];
+        skylineNode* node = &page->nodes[i];
+        const int shrink = prev->x + prev->width - node->x;
+        if (shrink <= 0)
+            break;
+
+        node->x += shrink;
+        node->width -= shrink;
+        if (node->width > 0)
+            break;
+
+        for (size_t j = i; j + 1 < page->nodec; ++j)
+            page->nodes[j] = page->nodes[j + 1];
+        page->nodec--;
+    }
+
+    for (size_t i = 0; i + 1 < page->nodec;) {
+        if (page->nodes[i].y == page->nodes[i + 1].y) {
+            page->nodes[i].width += page->nodes[i + 1].width;
+            for (size_t j = i + 1; j + 1 < page->nodec; ++j)
+                page->nodes[j] = page->nodes[j + 1];
+            page->nodec--;
+        } else {
+            ++i;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    size_t index; // first texture using this GL name
+    int w, h;     // padded size
+    int page, x, y;
+} atlasItem;
+
+static int compareItems(const void* a, const void* b) {
+    const atlasItem* l = a;
+    const atlasItem* r = b;
+    if (l->h != r->h)
+        return r->h - l->h;
+    return r->w - l->w;
+}
+
+bool atlasBuild(texture* textures, const size_t count, int pageSize, atlasStats* stats) {
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (pageSize > maxSize)
+        pageSize = maxSize;
+
+    // textures sharing a GL name (deduplicated ones) are packed once
+    atlasItem* items = malloc(sizeof(atlasItem) * count);
+    size_t itemc = 0;
+    *stats = (atlasStats){ .pageSize = pageSize };
+
+    for (size_t i = 0; i < count; ++i) {
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; ++j)
+            seen = textures[j].textureID == textures[i].textureID;
+        if (seen || textures[i].atlasPage >= 0 || textures[i].arrayLayer >= 0)
+            continue;
+
+        const int w = textureStoredWidth(&textures[i]) + ATLAS_PADDING;
+        const int h = textureStoredHeight(&textures[i]) + ATLAS_PADDING;
+        if (w > pageSize || h > pageSize || textures[i].layout != PIXEL_RGBA8) {
+            stats->skipped++;
+            continue;
+        }
+        items[itemc++] = (atlasItem){ i, w, h, -1, 0, 0 };
+    }
+
+    // tallest first keeps the skyline flat
+    qsort(items, itemc, sizeof(atlasItem), compareItems);
+
+    skylinePage* pages = nullptr;
+    int pagec = 0;
+    size_t usedTexels = 0;
+    for (size_t i = 0; i < itemc; ++i) {
+        atlasItem* item = &items[i];
+        for (int p = 0; p < pagec && item->page < 0; ++p) {
+            if (skylineInsert(&pages[p], item->w, item->h, &item->x, &item->y))
+                item->page = p;
+        }
+        if (item->page < 0) {
+            pages = realloc(pages, sizeof(skylinePage) * (pagec + 1));
+            skylineInit(&pages[pagec], pageSize);
+            skylineInsert(&pages[pagec], item->w, item->h, &item->x, &item->y);
+            item->page = pagec++;
+        }
+        usedTexels += (size_t)(item->w - ATLAS_PADDING) * (item->h - ATLAS_PADDING);
+    }
+    for (int p = 0; p < pagec; ++p)
+        free(pages[p].nodes);
+    free(pages);
+
+    GLuint* pageIDs = malloc(sizeof(GLuint) * (pagec ? pagec : 1));
+    glGenTextures(pagec, pageIDs);
+
+    GLuint fbos[2];
+    glGenFramebuffers(2, fbos);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+
+    for (int p = 0; p < pagec; ++p) {
+        glBindTexture(GL_TEXTURE_2D, pageIDs[p]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, pageSize, pageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // padding has to be transparent, not whatever the driver left there
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pageIDs[p], 0);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    GLuint* retired = malloc(sizeof(GLuint) * (itemc ? itemc : 1));
+    for (size_t i = 0; i < itemc; ++i) {
+        const atlasItem* item = &items[i];
+        const texture* src = &textures[item->index];
+        const int x = item->x + ATLAS_PADDING / 2;
+        const int y = item->y + ATLAS_PADDING / 2;
+        const int w = item->w - ATLAS_PADDING, h = item->h - ATLAS_PADDING;
+
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src->textureID, 0);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pageIDs[item->page], 0);
+        glBlitFramebuffer(0, 0, w, h,
+                          x, y, x + w, y + h,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        const GLuint oldID = src->textureID;
+        retired[i] = oldID;
+        for (size_t j = item->index; j < count; ++j) {
+            texture* tex = &textures[j];
+            if (tex->textureID != oldID)
+                continue;
+            tex->textureID = pageIDs[item->page];
+            tex->atlasPage = item->page;
+            tex->levels = 1;
+            tex->uvRect[0] = (float)x / pageSize;
+            tex->uvRect[1] = (float)y / pageSize;
+            tex->uvRect[2] = (float)(x + w) / pageSize;
+            tex->uvRect[3] = (float)(y + h) / pageSize;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(2, fbos);
+    glDeleteTextures(itemc, retired);
+
+    stats->pages = pagec;
+    stats->packed = itemc;
+    stats->efficiency = pagec ? (double)usedTexels / ((double)pagec * pageSize * pageSize) : 0.0;
+
+    free(retired);
+    free(pageIDs);
+    free(items);
+    return glGetError() == GL_NO_ERROR;
+}
@@ -0,0 +1,29 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stddef.h>
+
+#include "texture.h"
+
+// Repacks already uploaded textures into a few large atlas pages with a skyline
+// packer. Pixels are copied on the GPU, then each texture is rewritten in place to
+// point at its page with a matching uvRect and the original texture is deleted.
+// Textures too big for a page, or not stored as plain RGBA8 (the blits can't
+// convert layouts or touch compressed blocks), are left alone.
+// Pages have no mip levels: only level 0 is copied, so cooked mip chains are
+// dropped and sprites drawn well below full size alias. Mipmapping a page would
+// need gutters that grow with every level; use texture arrays to keep the chains.
+
+#define ATLAS_PADDING 2 // texels between neighbours, keeps bilinear taps from bleeding
+
+typedef struct {
+    int pages;
+    int pageSize;
+    size_t packed;  // distinct textures moved into pages
+    size_t skipped; // too large for a page or not RGBA8
+    double efficiency; // packed texels / total page texels
+} atlasStats;
+
+bool atlasBuild(texture* textures, size_t count, int pageSize, atlasStats* stats);
+
+#endif //ATLAS_H
@@ -0,0 +1,172 @@
+// batch_builder.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch_builder.h"
+
+typedef struct {
+    uint64_t state;
+    int32_t batch; // latest batch of the state, -1 for an empty slot
+} stateSlot;
+
+typedef struct {
+    uint32_t item;
+    int32_t batch;
+} placedItem;
+
+struct batchBuilder {
+    int cellSize;
+    int columns, rows;
+    int32_t* cells; // latest batch covering each cell, -1 for none
+    size_t cellCap;
+
+    stateSlot* states; // open addressed on state
+    size_t stateCap, statec;
+
+    placedItem* placed;
+    size_t placedc, placedCap;
+    int32_t batchc;
+
+    uint32_t* order;
+    size_t* starts;
+    size_t orderCap, startsCap;
+};
+
+batchBuilder* batchBuilderCreate(const int cellSize) {
+    batchBuilder* builder = calloc(1, sizeof(batchBuilder));
+    builder->cellSize = cellSize > 0 ? cellSize : 32;
+    builder->stateCap = 64;
+    builder->states = malloc(sizeof(stateSlot) * builder->stateCap);
+    return builder;
+}
+
+void batchBuilderDestroy(batchBuilder* builder) {
+    if (!builder)
+        return;
+    free(builder->cells);
+    free(builder->states);
+    free(builder->placed);
+    free(builder->order);
+    free(builder->starts);
+    free(builder);
+}
+
+void batchBuilderBegin(batchBuilder* builder, const int width, const int height) {
+    builder->columns = (width > 0 ? width : 1) / builder->cellSize + 1;
+    builder->rows = (height > 0 ? height : 1) / builder->cellSize + 1;
+    const size_t cellc = (size_t)builder->columns * builder->rows;
+    if (cellc > builder->cellCap) {
+        builder->cellCap = cellc;
+        builder->cells = realloc(builder->cells, sizeof(int32_t) * cellc);
+    }
+    memset(builder->cells, 0xFF, sizeof(int32_t) * cellc);
+
+    for (size_t i = 0; i < builder->stateCap; ++i)
+        builder->states[i].batch = -1;
+    builder->statec = 0;
+    builder->placedc = 0;
+    builder->batchc = 0;
+}
+
+static uint64_t hashState(uint64_t state) {
+    state ^= state >> 33;
+    state *= 0xff51afd7ed558ccdull;
+    state ^= state >> 33;
+    return state;
+}
+
+static stateSlot* findState(batchBuilder* builder, const uint64_t state) {
+    // kept under half full
+    if (builder->statec * 2 >= builder->stateCap) {
+        stateSlot* old = builder->states;
+        const size_t oldCap = builder->stateCap;
+        builder->stateCap *= 2;
+        builder->states = malloc(sizeof(stateSlot) * builder->stateCap);
+        for (size_t i = 0; i < builder->stateCap; ++i)
+            builder->states[i].batch = -1;
+        builder->statec = 0;
+        for (size_t i = 0; i < oldCap; ++i) {
+            if (old[i].batch >= 0) {
+                *findState(builder, old[i].state) = old[i];
+                builder->statec++;
+            }
+        }
+        free(old);
+    }
+
+    size_t slot = hashState(state) & (builder->stateCap - 1);
+    while (builder->states[slot].batch >= 0 && builder->states[slot].state != state)
+        slot = (slot + 1) & (builder->stateCap - 1);
+    return &builder->states[slot];
+}
+
+static int cellIndex(const float v, const int cellSize, const int count) {
+    const int c = (int)(v / (float)cellSize);
+    return c < 0 ? 0 : c >= count ? count - 1 : c;
+}
+
+void batchBuilderAdd(batchBuilder* builder, const uint64_t state, const float minX, const float minY, const float maxX, const float maxY,
+                     const uint32_t item) {
+    const int x0 = cellIndex(minX, builder->cellSize, builder->columns);
+    const int x1 = cellIndex(maxX, builder->cellSize, builder->columns);
+    const int y0 = cellIndex(minY, builder->cellSize, builder->rows);
+    const int y1 = cellIndex(maxY, builder->cellSize, builder->rows);
+
+    // the latest batch drawn under us, we can't move back past it
+    int32_t barrier = -1;
+    for (int y = y0; y <= y1; ++y) {
+        const int32_t* row = builder->cells + (size_t)y * builder->columns;
+        for (int x = x0; x <= x1; ++x) {
+            if (row[x] > barrier)
+                barrier = row[x];
+        }
+    }
+
+    stateSlot* slot = findState(builder, state);
+    int32_t batch;
+    if (slot->batch >= 0 && slot->batch >= barrier) {
+        batch = slot->batch;
+    } else {
+        if (slot->batch < 0)
+            builder->statec++;
+        slot->state = state;
+        batch = slot->batch = builder->batchc++;
+    }
+
+    for (int y = y0; y <= y1; ++y) {
+        int32_t* row = builder->cells + (size_t)y * builder->columns;
+        for (int x = x0; x <= x1; ++x) {
+            if (row[x] < batch)
+                row[x] = batch;
+        }
+    }
+
+    if (builder->placedc == builder->placedCap) {
+        builder->placedCap = builder->placedCap ? builder->placedCap * 2 : 1024;
+        builder->placed = realloc(builder->placed, sizeof(placedItem) * builder->placedCap);
+    }
+    builder->placed[builder->placedc++] = (placedItem){ item, batch };
+}
+
+const uint32_t* batchBuilderOrder(batchBuilder* builder, size_t* count, size_t* batches) {
+    *count = builder->placedc;
+    *batches = (size_t)builder->batchc;
+
+    // counting sort on batch, stable so each batch keeps submission order
+    if (builder->placedc > builder->orderCap) {
+        builder->orderCap = builder->placedc;
+        builder->order = realloc(builder->order, sizeof(uint32_t) * builder->orderCap);
+    }
+    if ((size_t)builder->batchc + 1 > builder->startsCap) {
+        builder->startsCap = (size_t)builder->batchc + 1;
+        builder->starts = realloc(builder->starts, sizeof(size_t) * builder->startsCap);
+    }
+    memset(builder->starts, 0, sizeof(size_t) * ((size_t)builder->batchc + 1));
+    for (size_t i = 0; i < builder->placedc; ++i)
+        builder->starts[builder->placed[i].batch + 1]++;
+    for (int32_t b = 0; b < builder->batchc; ++b)
+        builder->starts[b + 1] += builder->starts[b];
+    for (size_t i = 0; i < builder->placedc; ++i)
+        builder->order[builder->starts[builder->placed[i].batch]++] = builder->placed[i].item;
+    return builder->order;
+}
@@ -0,0 +1,27 @@
+#ifndef BATCH_BUILDER_H
+#define BATCH_BUILDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Groups a frame's draws into batches of equal state without changing what ends up
+// on screen. Draws come in submission (painter's) order. Each one joins the latest
+// batch of its state that it can be moved back to: it can't pass a draw whose bounds
+// intersect its own. A grid over the screen holds, per cell, the latest batch that
+// covers it, so finding how far back a draw may go costs only the cells it covers.
+// The grid is conservative, draws sharing a cell count as intersecting.
+
+typedef struct batchBuilder batchBuilder;
+
+batchBuilder* batchBuilderCreate(int cellSize);
+void batchBuilderDestroy(batchBuilder* builder);
+
+// bounds passed to batchBuilderAdd are clamped to width x height
+void batchBuilderBegin(batchBuilder* builder, int width, int height);
+// state is whatever has to match for two draws to share a batch, e.g. a drawKey without depth
+void batchBuilderAdd(batchBuilder* builder, uint64_t state, float minX, float minY, float maxX, float maxY, uint32_t item);
+
+// items in draw order, each batch's items next to each other and in submission order
+const uint32_t* batchBuilderOrder(batchBuilder* builder, size_t* count, size_t* batches);
+
+#endif //BATCH_BUILDER_H
@@ -0,0 +1,111 @@
+// batch_builder_test.c
+// Checks the batch builder's guarantee without GL: merged order is a permutation of the
+// draws, no two draws whose bounds intersect swap places, and draws that don't touch
+// still end up sharing batches.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch_builder.h"
+
+#define WIDTH  1920
+#define HEIGHT 1080
+
+typedef struct {
+    uint64_t state;
+    float minX, minY, maxX, maxY;
+} rect;
+
+static int Failures;
+
+static void check(const bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        Failures++;
+    }
+}
+
+static bool intersects(const rect* a, const rect* b) {
+    return a->minX <= b->maxX && b->minX <= a->maxX && a->minY <= b->maxY && b->minY <= a->maxY;
+}
+
+static const uint32_t* build(batchBuilder* builder, const rect* rects, const size_t rectc, size_t* batches) {
+    batchBuilderBegin(builder, WIDTH, HEIGHT);
+    for (size_t i = 0; i < rectc; ++i)
+        batchBuilderAdd(builder, rects[i].state, rects[i].minX, rects[i].minY, rects[i].maxX, rects[i].maxY, (uint32_t)i);
+    size_t count;
+    const uint32_t* order = batchBuilderOrder(builder, &count, batches);
+    check(count == rectc, "every draw comes out");
+    return order;
+}
+
+// random rectangles, a few of them off screen, over a handful of states
+static void checkRandom(batchBuilder* builder, const size_t rectc, const int states, const float size) {
+    rect* rects = malloc(sizeof(rect) * rectc);
+    for (size_t i = 0; i < rectc; ++i) {
+        const float x = (float)(rand() % (WIDTH + 200)) - 100, y = (float)(rand() % (HEIGHT + 200)) - 100;
+        const float w = 1 + (float)(rand() % (int)size), h = 1 + (float)(rand() % (int)size);
+        rects[i] = (rect){ (uint64_t)(rand() % states) << 40, x, y, x + w, y + h };
+    }
+
+    size_t batches;
+    const uint32_t* order = build(builder, rects, rectc, &batches);
+
+    // where each draw ended up
+    size_t* position = malloc(sizeof(size_t) * rectc);
+    memset(position, 0xFF, sizeof(size_t) * rectc);
+    bool permutation = true;
+    for (size_t p = 0; p < rectc; ++p) {
+        permutation &= order[p] < rectc && position[order[p]] == SIZE_MAX;
+        if (order[p] < rectc)
+            position[order[p]] = p;
+    }
+    check(permutation, "merged order is a permutation of the draws");
+
+    bool painterKept = true;
+    for (size_t i = 0; permutation && i < rectc; ++i) {
+        for (size_t j = i + 1; j < rectc; ++j) {
+            if (intersects(&rects[i], &rects[j]) && position[i] > position[j])
+                painterKept = false;
+        }
+    }
+    check(painterKept, "no intersecting pair is reordered");
+    check(batches <= rectc, "no more batches than draws");
+
+    free(position);
+    free(rects);
+}
+
+int main(void) {
+    srand(1);
+    batchBuilder* builder = batchBuilderCreate(32);
+
+    // A B A B far apart from each other merges into two batches
+    const rect apart[] = {
+        { 1, 0, 0, 10, 10 }, { 2, 100, 0, 110, 10 }, { 1, 200, 0, 210, 10 }, { 2, 300, 0, 310, 10 },
+    };
+    size_t batches;
+    const uint32_t* order = build(builder, apart, 4, &batches);
+    check(batches == 2, "separate draws of one state share a batch");
+    check(order[0] == 0 && order[1] == 2 && order[2] == 1 && order[3] == 3, "batches keep submission order");
+
+    // A B A stacked on top of each other can't merge
+    const rect stacked[] = { { 1, 0, 0, 50, 50 }, { 2, 10, 10, 60, 60 }, { 1, 20, 20, 70, 70 } };
+    order = build(builder, stacked, 3, &batches);
+    check(batches == 3, "overlapping draws stay in separate batches");
+    check(order[0] == 0 && order[1] == 1 && order[2] == 2, "overlapping draws keep painter's order");
+
+    for (int run = 0; run < 20; ++run) {
+        checkRandom(builder, 2000, 8, 64.0f);
+        checkRandom(builder, 500, 3, 400.0f);
+        checkRandom(builder, 5000, 200, 16.0f);
+    }
+    batchBuilderDestroy(builder);
+
+    if (Failures) {
+        fprintf(stderr, "%d batch builder checks failed\n", Failures);
+        return 1;
+    }
+    printf("Batch builder checks passed\n");
+    return 0;
+}
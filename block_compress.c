@@ -0,0 +1,621 @@
+// block_compress.c
+#include <math.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "block_compress.h"
+
+static void loadBlock(const unsigned char* rgba, const int width, const int height, const int bx, const int by, float px[16][4]) {
+    for (int y = 0; y < 4; ++y) {
+        const int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+        for (int x = 0; x < 4; ++x) {
+            const int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+            const unsigned char* p = rgba + ((size_t)sy * width + sx) * 4;
+            for (int c = 0; c < 4; ++c)
+                px[y * 4 + x][c] = p[c];
+        }
+    }
+}
+
+static void storeBlock(unsigned char* rgba, const int width, const int height, const int bx, const int by, const unsigned char px[16][4]) {
+    for (int y = 0; y < 4 && by * 4 + y < height; ++y) {
+        for (int x = 0; x < 4 && bx * 4 + x < width; ++x)
+            memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, px[y * 4 + x], 4);
+    }
+}
+
+static float clampByte(const float v) {
+    return v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v;
+}
+
+// endpoints at the ends of the block's principal axis over the first `channels` channels,
+// and the two pixels furthest out along it. the line fits gradients, the pixels fit
+// blocks of three or more flat colours where the line runs between all of them
+static void principalEndpoints(const float px[16][4], const int channels, float e0[4], float e1[4], float x0[4], float x1[4]) {
+    float mean[4] = { 0 };
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < channels; ++c)
+            mean[c] += px[i][c] / 16.0f;
+
+    float cov[4][4] = { 0 };
+    for (int i = 0; i < 16; ++i)
+        for (int a = 0; a < channels; ++a)
+            for (int b = 0; b < channels; ++b)
+                cov[a][b] += (px[i][a] - mean[a]) * (px[i][b] - mean[b]);
+
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iter = 0; iter < 8; ++iter) {
+        float next[4] = { 0 }, len = 0.0f;
+        for (int a = 0; a < channels; ++a) {
+            for (int b = 0; b < channels; ++b)
+                next[a] += cov[a][b] * axis[b];
+            len += next[a] * next[a];
+        }
+        if (len < 1e-12f)
+            break; // flat block, any axis will do
+        len = sqrtf(len);
+        for (int a = 0; a < channels; ++a)
+            axis[a] = next[a] / len;
+    }
+
+    float tmin = INFINITY, tmax = -INFINITY;
+    int imin = 0, imax = 0;
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            t += (px[i][c] - mean[c]) * axis[c];
+        if (t < tmin) {
+            tmin = t;
+            imin = i;
+        }
+        if (t > tmax) {
+            tmax = t;
+            imax = i;
+        }
+    }
+    for (int c = 0; c < channels; ++c) {
+        e0[c] = clampByte(mean[c] + tmin * axis[c]);
+        e1[c] = clampByte(mean[c] + tmax * axis[c]);
+        x0[c] = px[imin][c];
+        x1[c] = px[imax][c];
+    }
+}
+
+// best endpoints for fixed per-pixel weights toward e1. false if the weights don't pin them down
+static bool leastSquaresEndpoints(const float px[16][4], const float weights[16], const int first, const int channels,
+                                  float e0[4], float e1[4]) {
+    float aa = 0, ab = 0, bb = 0, xa[4] = { 0 }, xb[4] = { 0 };
+    for (int i = 0; i < 16; ++i) {
+        const float w = weights[i], v = 1.0f - w;
+        aa += v * v;
+        ab += v * w;
+        bb += w * w;
+        for (int c = first; c < first + channels; ++c) {
+            xa[c] += v * px[i][c];
+            xb[c] += w * px[i][c];
+        }
+    }
+    const float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f)
+        return false;
+    for (int c = first; c < first + channels; ++c) {
+        e0[c] = clampByte((bb * xa[c] - ab * xb[c]) / det);
+        e1[c] = clampByte((aa * xb[c] - ab * xa[c]) / det);
+    }
+    return true;
+}
+
+static void putBits(unsigned char* block, int* pos, const uint32_t value, const int count) {
+    for (int i = 0; i < count; ++i, ++*pos) {
+        if (value >> i & 1)
+            block[*pos >> 3] |= (unsigned char)(1u << (*pos & 7));
+    }
+}
+
+static uint32_t getBits(const unsigned char* block, int* pos, const int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; ++i, ++*pos)
+        value |= (uint32_t)(block[*pos >> 3] >> (*pos & 7) & 1) << i;
+    return value;
+}
+
+// ---- BC3 ----
+
+static uint16_t pack565(const float c[4]) {
+    const int r = ((int)(c[0] + 0.5f) * 31 + 127) / 255;
+    const int g = ((int)(c[1] + 0.5f) * 63 + 127) / 255;
+    const int b = ((int)(c[2] + 0.5f) * 31 + 127) / 255;
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void unpack565(const uint16_t v, int c[3]) {
+    const int r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+    c[0] = r << 3 | r >> 2;
+    c[1] = g << 2 | g >> 4;
+    c[2] = b << 3 | b >> 2;
+}
+
+// BC2/BC3 colour blocks always decode in four colour mode
+static void colorPalette(const uint16_t c0, const uint16_t c1, int palette[4][3]) {
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+static float fitColorIndices(const float px[16][4], const uint16_t c0, const uint16_t c1, unsigned char indices[16]) {
+    int palette[4][3];
+    colorPalette(c0, c1, palette);
+    float total = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float best = INFINITY;
+        for (int k = 0; k < 4; ++k) {
+            float err = 0.0f;
+            for (int c = 0; c < 3; ++c)
+                err += (px[i][c] - palette[k][c]) * (px[i][c] - palette[k][c]);
+            if (err < best) {
+                best = err;
+                indices[i] = (unsigned char)k;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+static void encodeColorBlock(const float px[16][4], unsigned char* out) {
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float e0[4], e1[4], x0[4], x1[4];
+    principalEndpoints(px, 3, e0, e1, x0, x1);
+    uint16_t c0 = pack565(e1), c1 = pack565(e0);
+    unsigned char indices[16];
+    float err = fitColorIndices(px, c0, c1, indices);
+    {
+        const uint16_t p0 = pack565(x1), p1 = pack565(x0);
+        unsigned char other[16];
+        const float otherErr = fitColorIndices(px, p0, p1, other);
+        if (otherErr < err) {
+            c0 = p0;
+            c1 = p1;
+            err = otherErr;
+            memcpy(indices, other, sizeof(indices));
+        }
+    }
+
+    // one least squares pass on the chosen indices, kept only if it helps
+    float w[16];
+    for (int i = 0; i < 16; ++i)
+        w[i] = weights[indices[i]];
+    if (leastSquaresEndpoints(px, w, 0, 3, e0, e1)) {
+        const uint16_t r0 = pack565(e0), r1 = pack565(e1);
+        unsigned char refined[16];
+        const float refinedErr = fitColorIndices(px, r0, r1, refined);
+        if (refinedErr < err) {
+            c0 = r0;
+            c1 = r1;
+            err = refinedErr;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    // keep c0 > c1 so decoders that still look at the order agree
+    if (c0 < c1) {
+        const uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+        static const unsigned char swapped[4] = { 1, 0, 3, 2 };
+        for (int i = 0; i < 16; ++i)
+            indices[i] = swapped[indices[i]];
+    } else if (c0 == c1) {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= (uint32_t)indices[i] << (i * 2);
+    out[0] = (unsigned char)c0;
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)c1;
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; ++i)
+        out[4 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+static void alphaPalette(const int a0, const int a1, int palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i < 7; ++i)
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (int i = 1; i < 5; ++i)
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static void encodeAlphaBlock(const float px[16][4], unsigned char* out) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        const int a = (int)px[i][3];
+        lo = a < lo ? a : lo;
+        hi = a > hi ? a : hi;
+    }
+
+    int palette[8];
+    alphaPalette(hi, lo, palette);
+    uint64_t bits = 0;
+    for (int i = 0; i < 16 && hi != lo; ++i) {
+        int best = 0, bestErr = 1 << 30;
+        for (int k = 0; k < 8; ++k) {
+            const int err = abs((int)px[i][3] - palette[k]);
+            if (err < bestErr) {
+                bestErr = err;
+                best = k;
+            }
+        }
+        bits |= (uint64_t)best << (i * 3);
+    }
+
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+void blockEncodeBC3(const unsigned char* rgba, const int width, const int height, unsigned char* out) {
+    const int bw = (width + 3) / 4, bh = (height + 3) / 4;
+    for (int by = 0; by < bh; ++by) {
+        for (int bx = 0; bx < bw; ++bx) {
+            float px[16][4];
+            loadBlock(rgba, width, height, bx, by, px);
+            unsigned char* block = out + ((size_t)by * bw + bx) * 16;
+            encodeAlphaBlock(px, block);
+            encodeColorBlock(px, block + 8);
+        }
+    }
+}
+
+void blockDecodeBC3(const unsigned char* blocks, const int width, const int height, unsigned char* rgba) {
+    const int bw = (width + 3) / 4, bh = (height + 3) / 4;
+    for (int by = 0; by < bh; ++by) {
+        for (int bx = 0; bx < bw; ++bx) {
+            const unsigned char* block = blocks + ((size_t)by * bw + bx) * 16;
+            int alphas[8], colors[4][3];
+            alphaPalette(block[0], block[1], alphas);
+            colorPalette((uint16_t)(block[8] | block[9] << 8), (uint16_t)(block[10] | block[11] << 8), colors);
+
+            uint64_t alphaBits = 0;
+            for (int i = 0; i < 6; ++i)
+                alphaBits |= (uint64_t)block[2 + i] << (i * 8);
+            const uint32_t colorBits = (uint32_t)block[12] | (uint32_t)block[13] << 8 | (uint32_t)block[14] << 16 | (uint32_t)block[15] << 24;
+
+            unsigned char px[16][4];
+            for (int i = 0; i < 16; ++i) {
+                const int* c = colors[colorBits >> (i * 2) & 3];
+                px[i][0] = (unsigned char)c[0];
+                px[i][1] = (unsigned char)c[1];
+                px[i][2] = (unsigned char)c[2];
+                px[i][3] = (unsigned char)alphas[alphaBits >> (i * 3) & 7];
+            }
+            storeBlock(rgba, width, height, bx, by, px);
+        }
+    }
+}
+
+// ---- BC7 modes 5 and 6 ----
+
+static const int bc7Weights2[4] = { 0, 21, 43, 64 };
+static const int bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static int bc7Interpolate(const int e0, const int e1, const int weight) {
+    return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// 7 bit channels plus one shared p-bit, whichever p-bit lands closer. alpha counts
+// extra so opaque blocks keep 255 rather than trading it for an exact colour
+static void quantizeEndpoint(const float e[4], int q[4], int* p) {
+    float bestErr = INFINITY;
+    for (int bit = 0; bit < 2; ++bit) {
+        int candidate[4];
+        float err = 0.0f;
+        for (int c = 0; c < 4; ++c) {
+            int v = (int)floorf((e[c] - (float)bit) / 2.0f + 0.5f);
+            v = v < 0 ? 0 : v > 127 ? 127 : v;
+            candidate[c] = v;
+            const float d = e[c] - (float)(v << 1 | bit);
+            err += d * d * (c == 3 ? 4.0f : 1.0f);
+        }
+        if (err < bestErr) {
+            bestErr = err;
+            memcpy(q, candidate, sizeof(candidate));
+            *p = bit;
+        }
+    }
+}
+
+// nearest of `count` palette entries over channels [first, first + channels), total squared error
+static float fitPalette(const float px[16][4], const int palette[][4], const int count, const int first, const int channels,
+                        unsigned char indices[16]) {
+    float total = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float best = INFINITY;
+        for (int k = 0; k < count; ++k) {
+            float err = 0.0f;
+            for (int c = first; c < first + channels; ++c)
+                err += (px[i][c] - palette[k][c]) * (px[i][c] - palette[k][c]);
+            if (err < best) {
+                best = err;
+                indices[i] = (unsigned char)k;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+typedef struct {
+    int q0[4], q1[4], p0, p1;
+    unsigned char indices[16];
+    float err;
+} mode6Fit;
+
+static void fitMode6(const float px[16][4], const float e0[4], const float e1[4], mode6Fit* fit) {
+    quantizeEndpoint(e0, fit->q0, &fit->p0);
+    quantizeEndpoint(e1, fit->q1, &fit->p1);
+    int palette[16][4];
+    for (int k = 0; k < 16; ++k)
+        for (int c = 0; c < 4; ++c)
+            palette[k][c] = bc7Interpolate(fit->q0[c] << 1 | fit->p0, fit->q1[c] << 1 | fit->p1, bc7Weights4[k]);
+    fit->err = fitPalette(px, palette, 16, 0, 4, fit->indices);
+}
+
+// least squares on the current indices until it stops helping
+static void refineMode6(const float px[16][4], mode6Fit* fit) {
+    for (int iter = 0; iter < 2; ++iter) {
+        float w[16], e0[4], e1[4];
+        for (int i = 0; i < 16; ++i)
+            w[i] = bc7Weights4[fit->indices[i]] / 64.0f;
+        if (!leastSquaresEndpoints(px, w, 0, 4, e0, e1))
+            return;
+        mode6Fit next;
+        fitMode6(px, e0, e1, &next);
+        if (next.err >= fit->err)
+            return;
+        *fit = next;
+    }
+}
+
+// one subset, RGBA endpoints on a single line with 16 steps
+static float encodeMode6(const float px[16][4], unsigned char* block) {
+    float e0[4], e1[4], x0[4], x1[4];
+    principalEndpoints(px, 4, e0, e1, x0, x1);
+
+    mode6Fit best, next;
+    fitMode6(px, e0, e1, &best);
+    refineMode6(px, &best);
+    fitMode6(px, x0, x1, &next);
+    refineMode6(px, &next);
+    if (next.err < best.err)
+        best = next;
+
+    // the first index is stored with its top bit implied zero
+    if (best.indices[0] & 8) {
+        next = best;
+        memcpy(best.q0, next.q1, sizeof(best.q0));
+        memcpy(best.q1, next.q0, sizeof(best.q1));
+        best.p0 = next.p1;
+        best.p1 = next.p0;
+        for (int i = 0; i < 16; ++i)
+            best.indices[i] = (unsigned char)(15 - best.indices[i]);
+    }
+
+    memset(block, 0, 16);
+    int pos = 0;
+    putBits(block, &pos, 1u << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        putBits(block, &pos, (uint32_t)best.q0[c], 7);
+        putBits(block, &pos, (uint32_t)best.q1[c], 7);
+    }
+    putBits(block, &pos, (uint32_t)best.p0, 1);
+    putBits(block, &pos, (uint32_t)best.p1, 1);
+    putBits(block, &pos, best.indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        putBits(block, &pos, best.indices[i], 4);
+    return best.err;
+}
+
+typedef struct {
+    int q0[4], q1[4]; // rgb 7 bit, alpha 8 bit
+    unsigned char indices[16];
+    float err;
+} mode5Fit;
+
+static int expand7(const int v) {
+    return v << 1 | v >> 6;
+}
+
+static void fitMode5Color(const float px[16][4], const float e0[4], const float e1[4], mode5Fit* fit) {
+    int palette[4][4];
+    for (int c = 0; c < 3; ++c) {
+        fit->q0[c] = (int)(e0[c] * 127.0f / 255.0f + 0.5f);
+        fit->q1[c] = (int)(e1[c] * 127.0f / 255.0f + 0.5f);
+        for (int k = 0; k < 4; ++k)
+            palette[k][c] = bc7Interpolate(expand7(fit->q0[c]), expand7(fit->q1[c]), bc7Weights2[k]);
+    }
+    fit->err = fitPalette(px, palette, 4, 0, 3, fit->indices);
+}
+
+static void fitMode5Alpha(const float px[16][4], const float a0, const float a1, mode5Fit* fit) {
+    int palette[4][4];
+    fit->q0[3] = (int)(a0 + 0.5f);
+    fit->q1[3] = (int)(a1 + 0.5f);
+    for (int k = 0; k < 4; ++k)
+        palette[k][3] = bc7Interpolate(fit->q0[3], fit->q1[3], bc7Weights2[k]);
+    fit->err = fitPalette(px, palette, 4, 3, 1, fit->indices);
+}
+
+// one subset with colour and alpha on separate lines, 4 steps each. wins on blocks
+// where alpha doesn't follow colour, e.g. two colours next to transparent texels
+static float encodeMode5(const float px[16][4], unsigned char* block) {
+    float e0[4], e1[4], x0[4], x1[4];
+    principalEndpoints(px, 3, e0, e1, x0, x1);
+
+    mode5Fit color, next;
+    fitMode5Color(px, e0, e1, &color);
+    fitMode5Color(px, x0, x1, &next);
+    if (next.err < color.err)
+        color = next;
+    float w[16];
+    for (int i = 0; i < 16; ++i)
+        w[i] = bc7Weights2[color.indices[i]] / 64.0f;
+    if (leastSquaresEndpoints(px, w, 0, 3, e0, e1)) {
+        fitMode5Color(px, e0, e1, &next);
+        if (next.err < color.err)
+            color = next;
+    }
+
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        lo = px[i][3] < lo ? px[i][3] : lo;
+        hi = px[i][3] > hi ? px[i][3] : hi;
+    }
+    mode5Fit alpha;
+    fitMode5Alpha(px, lo, hi, &alpha);
+    for (int i = 0; i < 16; ++i)
+        w[i] = bc7Weights2[alpha.indices[i]] / 64.0f;
+    if (leastSquaresEndpoints(px, w, 3, 1, e0, e1)) {
+        fitMode5Alpha(px, e0[3], e1[3], &next);
+        if (next.err < alpha.err)
+            alpha = next;
+    }
+
+    // both index sets store their first entry with the top bit implied zero
+    if (color.indices[0] & 2) {
+        for (int c = 0; c < 3; ++c) {
+            const int t = color.q0[c];
+            color.q0[c] = color.q1[c];
+            color.q1[c] = t;
+        }
+        for (int i = 0; i < 16; ++i)
+            color.indices[i] = (unsigned char)(3 - color.indices[i]);
+    }
+    if (alpha.indices[0] & 2) {
+        const int t = alpha.q0[3];
+        alpha.q0[3] = alpha.q1[3];
+        alpha.q1[3] = t;
+        for (int i = 0; i < 16; ++i)
+            alpha.indices[i] = (unsigned char)(3 - alpha.indices[i]);
+    }
+
+    memset(block, 0, 16);
+    int pos = 0;
+    putBits(block, &pos, 1u << 5, 6);
+    putBits(block, &pos, 0, 2); // no channel rotation
+    for (int c = 0; c < 3; ++c) {
+        putBits(block, &pos, (uint32_t)color.q0[c], 7);
+        putBits(block, &pos, (uint32_t)color.q1[c], 7);
+    }
+    putBits(block, &pos, (uint32_t)alpha.q0[3], 8);
+    putBits(block, &pos, (uint32_t)alpha.q1[3], 8);
+    putBits(block, &pos, color.indices[0], 1);
+    for (int i = 1; i < 16; ++i)
+        putBits(block, &pos, color.indices[i], 2);
+    putBits(block, &pos, alpha.indices[0], 1);
+    for (int i = 1; i < 16; ++i)
+        putBits(block, &pos, alpha.indices[i], 2);
+    return color.err + alpha.err;
+}
+
+void blockEncodeBC7(const unsigned char* rgba, const int width, const int height, unsigned char* out) {
+    const int bw = (width + 3) / 4, bh = (height + 3) / 4;
+    for (int by = 0; by < bh; ++by) {
+        for (int bx = 0; bx < bw; ++bx) {
+            float px[16][4];
+            loadBlock(rgba, width, height, bx, by, px);
+            unsigned char* block = out + ((size_t)by * bw + bx) * 16;
+            unsigned char mode5[16];
+            const float err6 = encodeMode6(px, block);
+            if (err6 > 0.0f && encodeMode5(px, mode5) < err6)
+                memcpy(block, mode5, 16);
+        }
+    }
+}
+
+static void decodeMode6(const unsigned char* block, unsigned char px[16][4]) {
+    int pos = 7, q0[4], q1[4];
+    for (int c = 0; c < 4; ++c) {
+        q0[c] = (int)getBits(block, &pos, 7);
+        q1[c] = (int)getBits(block, &pos, 7);
+    }
+    const int p0 = (int)getBits(block, &pos, 1), p1 = (int)getBits(block, &pos, 1);
+    for (int i = 0; i < 16; ++i) {
+        const int weight = bc7Weights4[getBits(block, &pos, i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; ++c)
+            px[i][c] = (unsigned char)bc7Interpolate(q0[c] << 1 | p0, q1[c] << 1 | p1, weight);
+    }
+}
+
+static void decodeMode5(const unsigned char* block, unsigned char px[16][4]) {
+    int pos = 6;
+    const int rotation = (int)getBits(block, &pos, 2);
+    int q0[4], q1[4];
+    for (int c = 0; c < 3; ++c) {
+        q0[c] = expand7((int)getBits(block, &pos, 7));
+        q1[c] = expand7((int)getBits(block, &pos, 7));
+    }
+    q0[3] = (int)getBits(block, &pos, 8);
+    q1[3] = (int)getBits(block, &pos, 8);
+    for (int i = 0; i < 16; ++i) {
+        const int weight = bc7Weights2[getBits(block, &pos, i == 0 ? 1 : 2)];
+        for (int c = 0; c < 3; ++c)
+            px[i][c] = (unsigned char)bc7Interpolate(q0[c], q1[c], weight);
+    }
+    for (int i = 0; i < 16; ++i) {
+        px[i][3] = (unsigned char)bc7Interpolate(q0[3], q1[3], bc7Weights2[getBits(block, &pos, i == 0 ? 1 : 2)]);
+        if (rotation) {
+            const unsigned char t = px[i][3];
+            px[i][3] = px[i][rotation - 1];
+            px[i][rotation - 1] = t;
+        }
+    }
+}
+
+bool blockDecodeBC7(const unsigned char* blocks, const int width, const int height, unsigned char* rgba) {
+    const int bw = (width + 3) / 4, bh = (height + 3) / 4;
+    bool ok = true;
+    for (int by = 0; by < bh; ++by) {
+        for (int bx = 0; bx < bw; ++bx) {
+            const unsigned char* block = blocks + ((size_t)by * bw + bx) * 16;
+            unsigned char px[16][4];
+            if ((block[0] & 0x7F) == 0x40) {
+                decodeMode6(block, px);
+            } else if ((block[0] & 0x3F) == 0x20) {
+                decodeMode5(block, px);
+            } else {
+                for (int i = 0; i < 16; ++i)
+                    memcpy(px[i], (const unsigned char[4]){ 255, 0, 255, 255 }, 4);
+                ok = false;
+            }
+            storeBlock(rgba, width, height, bx, by, px);
+        }
+    }
+    return ok;
+}
+
+double imagePSNR(const unsigned char* a, const unsigned char* b, const size_t pixelCount) {
+    double sum = 0.0;
+    for (size_t i = 0; i < pixelCount * 4; ++i) {
+        const double d = (double)a[i] - (double)b[i];
+        sum += d * d;
+    }
+    if (sum == 0.0)
+        return INFINITY;
+    const double mse = sum / (double)(pixelCount * 4);
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
@@ -0,0 +1,28 @@
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include <stddef.h>
+
+// CPU encoders for the two block formats packs can store, and decoders for
+// checking what they produce without a GPU. Both formats cost 16 bytes per 4x4
+// block of RGBA8 input. Blocks hanging over the right or bottom edge repeat the
+// last row or column.
+//   BC3: 565 colour endpoints on a principal axis plus a separate 8 level alpha ramp.
+//        fast, but colour and alpha each get only four or eight levels
+//   BC7: single subset modes only, whichever fits the block better:
+//        mode 6, 7.7.7.7 + p-bit RGBA endpoints on one 16 level ramp, or
+//        mode 5, 7.7.7 colour and 8 bit alpha endpoints on separate 4 level ramps.
+//        blocks of three unrelated colours still cost quality, the partitioned
+//        modes that would fix them are not searched
+
+void blockEncodeBC3(const unsigned char* rgba, int width, int height, unsigned char* out);
+void blockEncodeBC7(const unsigned char* rgba, int width, int height, unsigned char* out);
+
+void blockDecodeBC3(const unsigned char* blocks, int width, int height, unsigned char* rgba);
+// false if any block uses a BC7 mode other than 5 or 6, those decode to magenta
+bool blockDecodeBC7(const unsigned char* blocks, int width, int height, unsigned char* rgba);
+
+// peak signal to noise ratio over all four channels, in dB. identical images give INFINITY
+double imagePSNR(const unsigned char* a, const unsigned char* b, size_t pixelCount);
+
+#endif //BLOCK_COMPRESS_H
@@ -0,0 +1,315 @@
+// decode_pool.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include "decode_pool.h"
+#include "stb_image.h"
+#include "image_ops.h"
+#include "image_cache.h"
+#include "file_reader.h"
+
+typedef struct decodeNode {
+    decodeResult item;
+    bool read; // came back from the file reader, file holds the bytes
+    bool cached; // what was read is the image cache's file at cacheFile, not the image itself
+    char cacheFile[1024];
+    unsigned char* file;
+    size_t fileSize;
+    struct decodeNode* next;
+} decodeNode;
+
+typedef struct {
+    decodeNode *head, *tail;
+} decodeQueue;
+
+struct decodePool {
+    SDL_Thread** threads;
+    int threadCount;
+    unsigned flags;
+
+    SDL_Mutex* lock;
+    SDL_Condition* jobReady;
+    SDL_Condition* resultReady;
+
+    fileReader* reader; // nullptr without DECODE_BATCHED_IO
+    stagingBuffer* staging; // may be nullptr
+    decodeQueue jobs;
+    decodeQueue loaded; // files the reader finished, decoded ahead of new jobs
+    decodeQueue results;
+    size_t inFlight;
+    bool quit;
+};
+
+static void queuePush(decodeQueue* q, decodeNode* node) {
+    node->next = nullptr;
+    if (q->tail)
+        q->tail->next = node;
+    else
+        q->head = node;
+    q->tail = node;
+}
+
+static decodeNode* queuePop(decodeQueue* q) {
+    decodeNode* node = q->head;
+    if (node) {
+        q->head = node->next;
+        if (!q->head)
+            q->tail = nullptr;
+    }
+    return node;
+}
+
+static int decodeWorker(void* data) {
+    decodePool* pool = data;
+
+    SDL_LockMutex(pool->lock);
+    for (;;) {
+        while (!pool->jobs.head && !pool->loaded.head && !pool->quit)
+            SDL_WaitCondition(pool->jobReady, pool->lock);
+        if (pool->quit)
+            break;
+
+        decodeNode* node = pool->loaded.head ? queuePop(&pool->loaded) : queuePop(&pool->jobs);
+        SDL_UnlockMutex(pool->lock);
+
+        decodeResult* item = &node->item;
+        if (node->read && node->cached) {
+            item->pixels = imageCacheRead(item->path, node->file, node->fileSize, &item->sourceWidth, &item->sourceHeight);
+            free(node->file);
+            node->file = nullptr;
+            if (!item->pixels) {
+                // a miss goes back to the reader for the image itself
+                node->cached = false;
+                fileReaderSubmit(pool->reader, item->path, node);
+                SDL_LockMutex(pool->lock);
+                continue;
+            }
+        } else if (node->read) {
+            if (node->file)
+                item->pixels = imageCacheDecode(item->path, node->file, node->fileSize, &item->sourceWidth, &item->sourceHeight,
+                                                &item->failure);
+            free(node->file);
+            node->file = nullptr;
+        } else if (pool->reader) {
+            // the cache file is tried first, so hits are batched with the reader like everything else
+            node->cached = imageCacheFile(item->path, node->cacheFile, sizeof(node->cacheFile));
+            fileReaderSubmit(pool->reader, node->cached ? node->cacheFile : item->path, node);
+            SDL_LockMutex(pool->lock);
+            continue;
+        } else {
+            item->pixels = imageCacheLoad(item->path, &item->sourceWidth, &item->sourceHeight, &item->failure);
+        }
+
+        item->width = item->sourceWidth;
+        item->height = item->sourceHeight;
+        if (item->pixels && pool->flags & DECODE_TRIM) {
+            imageTrimBounds(item->pixels, item->sourceWidth, item->sourceHeight, &item->trimX, &item->trimY, &item->width, &item->height);
+            imageCropInPlace(item->pixels, item->sourceWidth, item->trimX, item->trimY, item->width, item->height);
+        }
+        item->trimWidth = item->width;
+        item->trimHeight = item->height;
+        if (item->pixels && pool->flags & DECODE_PREMULTIPLY)
+            imagePremultiply(item->pixels, (size_t)item->width * item->height);
+        for (int i = 0; item->pixels && i < item->lod; ++i) {
+            imageDownsample(item->pixels, item->width, item->height, item->pixels);
+            item->width = item->width > 1 ? item->width / 2 : 1;
+            item->height = item->height > 1 ? item->height / 2 : 1;
+        }
+        item->layout = PIXEL_RGBA8;
+        const size_t count = (size_t)item->width * item->height;
+        if (item->pixels && pool->flags & DECODE_NARROW)
+            item->layout = imageNarrowestLayout(item->pixels, count, pool->flags & DECODE_LOSSY);
+        // indices only pay for the palette once they replace more than a byte a pixel
+        if (item->pixels && pool->flags & DECODE_PALETTE && pixelLayoutSize(item->layout) > 1 &&
+            count * (pixelLayoutSize(item->layout) - 1) > PALETTE_BYTES) {
+            unsigned char* palette = calloc(1, PALETTE_BYTES);
+            const int colors = imageBuildPalette(item->pixels, count, palette);
+            if (colors) {
+                imageApplyPalette(item->pixels, count, palette, colors);
+                item->layout = PIXEL_INDEXED8;
+                item->palette = palette;
+            } else {
+                free(palette);
+            }
+        }
+        if (item->pixels && item->layout != PIXEL_INDEXED8)
+            imageConvertLayout(item->pixels, count, item->layout);
+        if (item->pixels && pool->flags & DECODE_HASH) {
+            item->hash = imageHash(item->pixels, count * pixelLayoutSize(item->layout));
+            if (item->palette)
+                item->hash ^= imageHash(item->palette, PALETTE_BYTES) * 0x100000001b3ull;
+        }
+        // stb can't decode into memory we pick, so this is the one copy, and the GL thread makes none.
+        // a full buffer isn't waited on, the image just goes through the GL thread's own PBO
+        unsigned char* mapped;
+        const size_t bytes = count * pixelLayoutSize(item->layout);
+        if (item->pixels && pool->staging && stagingBufferAlloc(pool->staging, bytes, &item->stagingOffset, &mapped)) {
+            memcpy(mapped, item->pixels, bytes);
+            stbi_image_free(item->pixels);
+            item->pixels = mapped;
+            item->staged = true;
+        }
+
+        SDL_LockMutex(pool->lock);
+        queuePush(&pool->results, node);
+        SDL_SignalCondition(pool->resultReady);
+    }
+    SDL_UnlockMutex(pool->lock);
+    return 0;
+}
+
+static void fileRead(void* context, void* user, unsigned char* data, const size_t size, const char* failure) {
+    decodePool* pool = context;
+    decodeNode* node = user;
+    node->read = true;
+    node->file = data;
+    node->fileSize = size;
+    node->item.failure = failure;
+
+    SDL_LockMutex(pool->lock);
+    queuePush(&pool->loaded, node);
+    SDL_SignalCondition(pool->jobReady);
+    SDL_UnlockMutex(pool->lock);
+}
+
+void decodePredict(const manifestEntry* entry, const unsigned flags, const int lod, int* width, int* height, pixelLayout* layout) {
+    const bool trim = flags & DECODE_TRIM;
+    int w = (int)(trim ? entry->trimWidth : entry->width);
+    int h = (int)(trim ? entry->trimHeight : entry->height);
+    for (int i = 0; i < lod; ++i) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    *width = w;
+    *height = h;
+
+    // the same choices the worker makes from the pixels
+    const bool premultiplied = flags & DECODE_PREMULTIPLY;
+    pixelLayout l = PIXEL_RGBA8;
+    if (flags & DECODE_NARROW) {
+        l = (pixelLayout)(premultiplied ? entry->premultipliedLayout : entry->layout);
+        if (l == PIXEL_RGB8 && flags & DECODE_LOSSY)
+            l = PIXEL_RGB565;
+    }
+    const size_t count = (size_t)w * h;
+    const uint32_t colors = premultiplied ? entry->premultipliedColors : entry->colors;
+    if (flags & DECODE_PALETTE && colors && pixelLayoutSize(l) > 1 && count * (pixelLayoutSize(l) - 1) > PALETTE_BYTES)
+        l = PIXEL_INDEXED8;
+    *layout = l;
+}
+
+int decodePoolDefaultThreads(void) {
+    const int cores = SDL_GetNumLogicalCPUCores();
+    return cores > 0 ? cores : 1;
+}
+
+decodePool* decodePoolCreate(int threadCount, const unsigned flags) {
+    if (threadCount < 1)
+        threadCount = 1;
+
+    decodePool* pool = calloc(1, sizeof(decodePool));
+    pool->flags = flags;
+    pool->lock = SDL_CreateMutex();
+    pool->jobReady = SDL_CreateCondition();
+    pool->resultReady = SDL_CreateCondition();
+    pool->threads = malloc(sizeof(SDL_Thread*) * threadCount);
+
+    for (int i = 0; i < threadCount; ++i) {
+        pool->threads[i] = SDL_CreateThread(decodeWorker, "decode", pool);
+        if (!pool->threads[i]) {
+            fprintf(stderr, "Failed to start decode thread: %s\n", SDL_GetError());
+            break;
+        }
+        pool->threadCount++;
+    }
+
+    if (pool->threadCount == 0) {
+        decodePoolDestroy(pool);
+        return nullptr;
+    }
+
+    // reads mostly wait on the disk, so the fallback gets more threads than decoding does
+    if (flags & DECODE_BATCHED_IO)
+        pool->reader = fileReaderCreate(threadCount * 2, !(flags & DECODE_IO_THREADS), fileRead, pool);
+    return pool;
+}
+
+void decodePoolDestroy(decodePool* pool) {
+    if (!pool)
+        return;
+
+    SDL_LockMutex(pool->lock);
+    pool->quit = true;
+    SDL_BroadcastCondition(pool->jobReady);
+    SDL_UnlockMutex(pool->lock);
+
+    for (int i = 0; i < pool->threadCount; ++i)
+        SDL_WaitThread(pool->threads[i], nullptr);
+    // lets reads still in flight land in loaded, to be freed below
+    fileReaderDestroy(pool->reader);
+
+    decodeNode* node;
+    while ((node = queuePop(&pool->jobs)))
+        free(node);
+    while ((node = queuePop(&pool->loaded))) {
+        free(node->file);
+        free(node);
+    }
+    while ((node = queuePop(&pool->results))) {
+        // staged pixels go with the staging buffer
+        if (!node->item.staged)
+            stbi_image_free(node->item.pixels);
+        free(node->item.palette);
+        free(node);
+    }
+
+    SDL_DestroyCondition(pool->resultReady);
+    SDL_DestroyCondition(pool->jobReady);
+    SDL_DestroyMutex(pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+void decodePoolSetStaging(decodePool* pool, stagingBuffer* staging) {
+    pool->staging = staging;
+}
+
+void decodePoolSubmit(decodePool* pool, const size_t index, const char* path, const int lod) {
+    decodeNode* node = calloc(1, sizeof(decodeNode));
+    node->item.index = index;
+    node->item.path = path;
+    node->item.lod = lod;
+
+    SDL_LockMutex(pool->lock);
+    queuePush(&pool->jobs, node);
+    pool->inFlight++;
+    SDL_SignalCondition(pool->jobReady);
+    SDL_UnlockMutex(pool->lock);
+}
+
+const char* decodePoolIoBackend(const decodePool* pool) {
+    return pool->reader ? fileReaderBackend(pool->reader) : "blocking";
+}
+
+bool decodePoolPop(decodePool* pool, decodeResult* out, const bool wait) {
+    SDL_LockMutex(pool->lock);
+    if (wait) {
+        while (!pool->results.head && pool->inFlight > 0)
+            SDL_WaitCondition(pool->resultReady, pool->lock);
+    }
+
+    decodeNode* node = queuePop(&pool->results);
+    if (node)
+        pool->inFlight--;
+    SDL_UnlockMutex(pool->lock);
+
+    if (!node)
+        return false;
+
+    *out = node->item;
+    free(node);
+    return true;
+}
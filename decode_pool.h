@@ -0,0 +1,68 @@
+#ifndef DECODE_POOL_H
+#define DECODE_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image_ops.h"
+#include "image_manifest.h"
+#include "staging_buffer.h"
+
+// Worker threads that run stbi_load (through imageCacheLoad) off the GL thread. Jobs go in with
+// decodePoolSubmit and finished pixel buffers come back, in completion
+// order, through decodePoolPop so the GL thread only has to upload them.
+
+enum {
+    DECODE_TRIM = 1u << 0, // crop transparent borders, see imageTrimBounds
+    DECODE_HASH = 1u << 1, // fill in hash, for spotting identical images
+    DECODE_PREMULTIPLY = 1u << 2, // premultiply alpha, before any lod halving
+    DECODE_NARROW = 1u << 3, // repack into imageNarrowestLayout, see layout
+    DECODE_LOSSY = 1u << 4,  // with DECODE_NARROW, opaque colour images may become RGB565
+    DECODE_PALETTE = 1u << 5, // images of 256 colours or fewer become PIXEL_INDEXED8 when that is smaller
+    DECODE_BATCHED_IO = 1u << 6, // files are read by a fileReader and decoded from memory as they arrive
+    DECODE_IO_THREADS = 1u << 7, // with DECODE_BATCHED_IO, use the reader's thread fallback even where io_uring works
+};
+
+typedef struct {
+    size_t index;
+    const char* path;
+    unsigned char* pixels; // in layout, free with stbi_image_free unless staged. nullptr if decoding failed
+    bool staged;           // pixels live in the pool's staging buffer at stagingOffset, hand them back with stagingBufferRelease
+    size_t stagingOffset;
+    int width, height;     // size of pixels
+    int sourceWidth, sourceHeight;
+    int trimX, trimY;      // where the trimmed rect sits inside the source image
+    int trimWidth, trimHeight;
+    int lod;               // times the trimmed rect was halved before it became pixels
+    pixelLayout layout;    // PIXEL_RGBA8 unless DECODE_NARROW or DECODE_PALETTE found a smaller one
+    unsigned char* palette; // 256 RGBA colours for PIXEL_INDEXED8, otherwise nullptr. free with free
+    uint64_t hash;         // imageHash of pixels (and palette) when DECODE_HASH is set
+    const char* failure;
+} decodeResult;
+
+typedef struct decodePool decodePool;
+
+int decodePoolDefaultThreads(void);
+
+decodePool* decodePoolCreate(int threadCount, unsigned flags);
+void decodePoolDestroy(decodePool* pool);
+
+// finished images are copied into staging when it has room, see decodeResult.staged.
+// call before the first decodePoolSubmit
+void decodePoolSetStaging(decodePool* pool, stagingBuffer* staging);
+
+// lod > 0 box filters the (trimmed) image down that many times before it is handed back
+void decodePoolSubmit(decodePool* pool, size_t index, const char* path, int lod);
+
+// the size and layout a decode of the image entry describes will come back with, so storage can
+// be allocated before decoding. exact for trimmed lod 0 loads; lod halving can mix new colours in,
+// so treat the layout as a guess there
+void decodePredict(const manifestEntry* entry, unsigned flags, int lod, int* width, int* height, pixelLayout* layout);
+
+// how files get read: "blocking", or the fileReader backend with DECODE_BATCHED_IO
+const char* decodePoolIoBackend(const decodePool* pool);
+
+// returns false when nothing is ready (wait == false) or nothing is left in flight
+bool decodePoolPop(decodePool* pool, decodeResult* out, bool wait);
+
+#endif //DECODE_POOL_H
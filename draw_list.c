@@ -0,0 +1,79 @@
+// draw_list.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "draw_list.h"
+
+struct drawList {
+    drawItem* items;
+    drawItem* scratch;
+    size_t count, cap;
+};
+
+void drawItemsSort(drawItem* items, drawItem* scratch, const size_t count) {
+    // every byte's histogram in one read of the keys
+    size_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t key = items[i].key;
+        for (int b = 0; b < 8; ++b)
+            counts[b][key >> (b * 8) & 0xFF]++;
+    }
+
+    drawItem* from = items;
+    drawItem* to = scratch;
+    for (int b = 0; b < 8; ++b) {
+        size_t* c = counts[b];
+        if (count == 0 || c[from[0].key >> (b * 8) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            const size_t n = c[d];
+            c[d] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i)
+            to[c[from[i].key >> (b * 8) & 0xFF]++] = from[i];
+
+        drawItem* t = from;
+        from = to;
+        to = t;
+    }
+    if (from != items)
+        memcpy(items, from, sizeof(drawItem) * count);
+}
+
+drawList* drawListCreate(void) {
+    return calloc(1, sizeof(drawList));
+}
+
+void drawListDestroy(drawList* list) {
+    if (!list)
+        return;
+    free(list->items);
+    free(list->scratch);
+    free(list);
+}
+
+void drawListClear(drawList* list) {
+    list->count = 0;
+}
+
+void drawListAdd(drawList* list, const uint64_t key, const uint32_t item) {
+    if (list->count == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 1024;
+        list->items = realloc(list->items, sizeof(drawItem) * list->cap);
+        list->scratch = realloc(list->scratch, sizeof(drawItem) * list->cap);
+    }
+    list->items[list->count++] = (drawItem){ key, item };
+}
+
+void drawListSort(drawList* list) {
+    drawItemsSort(list->items, list->scratch, list->count);
+}
+
+const drawItem* drawListItems(const drawList* list, size_t* count) {
+    *count = list->count;
+    return list->items;
+}
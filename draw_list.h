@@ -0,0 +1,44 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A frame's draws as 64-bit sort keys, each carrying the index of what it draws.
+// Sorting the keys puts draws that share state next to each other, so the
+// renderer binds every layer, program and texture as few times as possible.
+// Key layout, most significant first:
+//   layer    8 bits  drawn back to front
+//   program  4 bits  see SPRITE_PROGRAM_*
+//   texture 24 bits  GL name, atlas page or array
+//   palette 12 bits  GL name of an indexed texture's palette, 0 otherwise
+//   depth   16 bits  back to front within the same state
+// The sort is stable, equal keys keep the order they were added in.
+
+typedef struct {
+    uint64_t key;
+    uint32_t item;
+} drawItem;
+
+static inline uint64_t drawKey(const unsigned layer, const unsigned program, const unsigned texture, const unsigned palette,
+                               const unsigned depth) {
+    return (uint64_t)(layer & 0xFFu) << 56 | (uint64_t)(program & 0xFu) << 52 | (uint64_t)(texture & 0xFFFFFFu) << 28 |
+           (uint64_t)(palette & 0xFFFu) << 16 | (uint64_t)(depth & 0xFFFFu);
+}
+
+// LSD radix sort on key, a byte per pass. passes where every key has the same byte are skipped,
+// which is most of them for a frame's keys. scratch holds count items
+void drawItemsSort(drawItem* items, drawItem* scratch, size_t count);
+
+typedef struct drawList drawList;
+
+drawList* drawListCreate(void);
+void drawListDestroy(drawList* list);
+
+void drawListClear(drawList* list);
+void drawListAdd(drawList* list, uint64_t key, uint32_t item);
+void drawListSort(drawList* list);
+
+const drawItem* drawListItems(const drawList* list, size_t* count);
+
+#endif //DRAW_LIST_H
@@ -0,0 +1,36 @@
+// embedded_pack.c
+#include "embedded_pack.h"
+
+#ifndef EMBEDDED_TEXTURE_PACK
+#error "embedded_pack.c needs EMBEDDED_TEXTURE_PACK, the path of the pack to link in"
+#endif
+
+// .incbin copies the file into a read-only section at assemble time. aligned like the
+// blobs inside the pack, so uploads straight from it stay aligned
+#if defined(__APPLE__)
+#define EMBED_SECTION ".const_data"
+#define EMBED_SYMBOL(name) "_" #name
+#elif defined(_WIN32)
+#define EMBED_SECTION ".rdata,\"dr\""
+#define EMBED_SYMBOL(name) #name
+#else
+#define EMBED_SECTION ".rodata"
+#define EMBED_SYMBOL(name) #name
+#endif
+
+__asm__(".section " EMBED_SECTION "\n"
+        ".balign 64\n"
+        ".globl " EMBED_SYMBOL(embeddedPackStart) "\n"
+        EMBED_SYMBOL(embeddedPackStart) ":\n"
+        ".incbin \"" EMBEDDED_TEXTURE_PACK "\"\n"
+        ".globl " EMBED_SYMBOL(embeddedPackEnd) "\n"
+        EMBED_SYMBOL(embeddedPackEnd) ":\n"
+        ".byte 0\n"
+        ".text\n");
+
+extern const unsigned char embeddedPackStart[];
+extern const unsigned char embeddedPackEnd[];
+
+texturePack* embeddedPackOpen(void) {
+    return texturePackOpenMemory(embeddedPackStart, (size_t)(embeddedPackEnd - embeddedPackStart), "<embedded>");
+}
@@ -0,0 +1,11 @@
+#ifndef EMBEDDED_PACK_H
+#define EMBEDDED_PACK_H
+
+#include "texture_pack.h"
+
+// The cooked assets.pack linked into the executable itself (EMBED_ASSETS builds, where
+// EMBEDDED_TEXTURE_PACK names the file to link). Nothing is opened or read at startup,
+// the kernel pages the blobs in from the executable as GL reads them.
+texturePack* embeddedPackOpen(void);
+
+#endif //EMBEDDED_PACK_H
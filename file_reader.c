@@ -0,0 +1,438 @@
+// file_reader.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include "file_reader.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define URING_ENTRIES 64 // reads in flight, each holds a file descriptor open
+#endif
+
+typedef struct readRequest {
+    const char* path;
+    void* user;
+    int fd;
+    unsigned char* data;
+    size_t size, done;
+    struct readRequest* next;
+    struct readRequest *prevActive, *nextActive; // io_uring: requests with an op in the ring
+} readRequest;
+
+#ifdef __linux__
+typedef struct {
+    int fd;
+    unsigned entries;
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize;
+    struct io_uring_sqe* sqes;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe* cqes;
+    unsigned queued; // sqes written since the last io_uring_enter
+    readRequest* active;
+} uring;
+#endif
+
+struct fileReader {
+    fileReadDone done;
+    void* context;
+
+    SDL_Thread** threads;
+    int threadCount;
+    SDL_Mutex* lock;
+    SDL_Condition* wake;
+    readRequest *head, *tail;
+    bool quit;
+
+#ifdef __linux__
+    bool useUring;
+    uring ring;
+#endif
+};
+
+static readRequest* popRequest(fileReader* reader) {
+    readRequest* r = reader->head;
+    if (r) {
+        reader->head = r->next;
+        if (!reader->head)
+            reader->tail = nullptr;
+    }
+    return r;
+}
+
+static void finishRequest(fileReader* reader, readRequest* r, const char* failure) {
+    if (failure) {
+        free(r->data);
+        r->data = nullptr;
+        r->size = 0;
+    }
+    reader->done(reader->context, r->user, r->data, r->size, failure);
+    free(r);
+}
+
+// ---- blocking fallback ----
+
+static int readerThread(void* data) {
+    fileReader* reader = data;
+
+    SDL_LockMutex(reader->lock);
+    for (;;) {
+        while (!reader->head && !reader->quit)
+            SDL_WaitCondition(reader->wake, reader->lock);
+        readRequest* r = popRequest(reader);
+        if (!r)
+            break;
+        SDL_UnlockMutex(reader->lock);
+
+        const char* failure = nullptr;
+        FILE* f = fopen(r->path, "rb");
+        if (!f) {
+            failure = "can't fopen";
+        } else {
+            fseek(f, 0, SEEK_END);
+            const long size = ftell(f);
+            fseek(f, 0, SEEK_SET);
+            r->size = size > 0 ? (size_t)size : 0;
+            r->data = malloc(r->size ? r->size : 1);
+            if (size < 0 || fread(r->data, 1, r->size, f) != r->size)
+                failure = "short read";
+            fclose(f);
+        }
+        finishRequest(reader, r, failure);
+
+        SDL_LockMutex(reader->lock);
+    }
+    SDL_UnlockMutex(reader->lock);
+    return 0;
+}
+
+// ---- io_uring ----
+
+#ifdef __linux__
+static bool uringOpSupported(const struct io_uring_probe* probe, const int op) {
+    return probe->last_op >= op && probe->ops[op].flags & IO_URING_OP_SUPPORTED;
+}
+
+static bool uringSetup(uring* ring) {
+    struct io_uring_params params = { 0 };
+    ring->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring->fd < 0)
+        return false;
+    ring->entries = params.sq_entries;
+
+    // async openat and read need 5.6, older kernels take the fallback
+    const size_t probeSize = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, probeSize);
+    const bool supported = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) >= 0 &&
+                           uringOpSupported(probe, IORING_OP_OPENAT) && uringOpSupported(probe, IORING_OP_READ);
+    free(probe);
+    if (!supported) {
+        close(ring->fd);
+        return false;
+    }
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        if (ring->cqRingSize > ring->sqRingSize)
+            ring->sqRingSize = ring->cqRingSize;
+        ring->cqRingSize = ring->sqRingSize;
+    }
+
+    ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cqRing = single ? ring->sqRing
+                          : mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(nullptr, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        close(ring->fd);
+        return false;
+    }
+
+    unsigned char* sq = ring->sqRing;
+    unsigned char* cq = ring->cqRing;
+    ring->sqHead = (unsigned*)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned*)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned*)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return true;
+}
+
+static void uringTeardown(uring* ring) {
+    munmap(ring->sqes, ring->entries * sizeof(struct io_uring_sqe));
+    if (ring->cqRing != ring->sqRing)
+        munmap(ring->cqRing, ring->cqRingSize);
+    munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+}
+
+// only the reader thread touches the rings, the kernel is the other side
+static struct io_uring_sqe* uringNextSqe(uring* ring) {
+    const unsigned tail = *ring->sqTail;
+    const unsigned index = tail & *ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+    return sqe;
+}
+
+static void uringQueueOpen(uring* ring, readRequest* r) {
+    struct io_uring_sqe* sqe = uringNextSqe(ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)r->path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = (uint64_t)(uintptr_t)r;
+}
+
+static void uringQueueRead(uring* ring, readRequest* r) {
+    const size_t left = r->size - r->done;
+    struct io_uring_sqe* sqe = uringNextSqe(ring);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = r->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(r->data + r->done);
+    sqe->len = left > (1u << 30) ? 1u << 30 : (unsigned)left;
+    sqe->off = r->done;
+    sqe->user_data = (uint64_t)(uintptr_t)r;
+}
+
+static void uringActivate(uring* ring, readRequest* r) {
+    r->prevActive = nullptr;
+    r->nextActive = ring->active;
+    if (ring->active)
+        ring->active->prevActive = r;
+    ring->active = r;
+}
+
+static void uringFinish(fileReader* reader, readRequest* r, const char* failure) {
+    if (r->prevActive)
+        r->prevActive->nextActive = r->nextActive;
+    else
+        reader->ring.active = r->nextActive;
+    if (r->nextActive)
+        r->nextActive->prevActive = r->prevActive;
+    finishRequest(reader, r, failure);
+}
+
+// io_uring_enter broke, so nothing left in the ring will complete. puts every request it held
+// back at the front of the queue for the blocking reader to redo. the kernel may still write
+// into their buffers, so those are leaked instead of freed
+static void uringAbandon(fileReader* reader) {
+    uring* ring = &reader->ring;
+    SDL_LockMutex(reader->lock);
+    while (ring->active) {
+        readRequest* r = ring->active;
+        ring->active = r->nextActive;
+        if (r->fd >= 0)
+            close(r->fd);
+        r->fd = -1;
+        r->data = nullptr;
+        r->size = r->done = 0;
+        r->next = reader->head;
+        reader->head = r;
+        if (!reader->tail)
+            reader->tail = r;
+    }
+    SDL_UnlockMutex(reader->lock);
+}
+
+// moves a request on to its next op. returns true once it is finished
+static bool uringAdvance(fileReader* reader, readRequest* r, const int res) {
+    if (r->fd < 0) {
+        // open finished. the inode is in memory now, fstat doesn't go to the disk
+        struct stat st;
+        if (res < 0 || fstat(res, &st) != 0) {
+            if (res >= 0)
+                close(res);
+            uringFinish(reader, r, "can't open");
+            return true;
+        }
+        r->fd = res;
+        r->size = (size_t)st.st_size;
+        r->data = malloc(r->size ? r->size : 1);
+    } else if (res > 0) {
+        r->done += (size_t)res;
+    } else if (res != -EINTR && res != -EAGAIN) {
+        close(r->fd);
+        uringFinish(reader, r, "short read");
+        return true;
+    }
+
+    if (r->done == r->size) {
+        close(r->fd);
+        uringFinish(reader, r, nullptr);
+        return true;
+    }
+    uringQueueRead(&reader->ring, r);
+    return false;
+}
+
+static int uringThread(void* data) {
+    fileReader* reader = data;
+    uring* ring = &reader->ring;
+    unsigned inFlight = 0;
+
+    for (;;) {
+        SDL_LockMutex(reader->lock);
+        while (!reader->head && inFlight == 0 && !reader->quit)
+            SDL_WaitCondition(reader->wake, reader->lock);
+        if (!reader->head && inFlight == 0) {
+            SDL_UnlockMutex(reader->lock);
+            break;
+        }
+        // every request has one op queued at a time, so the ring never overflows
+        readRequest* r;
+        while (inFlight < ring->entries && (r = popRequest(reader))) {
+            r->fd = -1;
+            uringActivate(ring, r);
+            uringQueueOpen(ring, r);
+            inFlight++;
+        }
+        SDL_UnlockMutex(reader->lock);
+
+        const int submitted = (int)syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        const bool broken = submitted < 0 && errno != EINTR && errno != EBUSY;
+        if (broken)
+            fprintf(stderr, "io_uring_enter failed, reading the rest with blocking reads: %s\n", strerror(errno));
+        if (submitted > 0)
+            ring->queued -= (unsigned)submitted;
+
+        unsigned head = *ring->cqHead;
+        const unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cqMask];
+            if (uringAdvance(reader, (readRequest*)(uintptr_t)cqe->user_data, cqe->res))
+                inFlight--;
+        }
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+        if (broken) {
+            uringAbandon(reader);
+            return readerThread(reader);
+        }
+    }
+    return 0;
+}
+#endif
+
+fileReader* fileReaderCreate(int threadCount, const bool useUring, const fileReadDone done, void* context) {
+    if (threadCount < 1)
+        threadCount = 1;
+
+    fileReader* reader = calloc(1, sizeof(fileReader));
+    reader->done = done;
+    reader->context = context;
+    reader->lock = SDL_CreateMutex();
+    reader->wake = SDL_CreateCondition();
+
+#ifdef __linux__
+    reader->useUring = useUring && uringSetup(&reader->ring);
+    if (reader->useUring)
+        threadCount = 1;
+#else
+    (void)useUring;
+#endif
+
+    reader->threads = malloc(sizeof(SDL_Thread*) * threadCount);
+    for (int i = 0; i < threadCount; ++i) {
+#ifdef __linux__
+        reader->threads[i] = SDL_CreateThread(reader->useUring ? uringThread : readerThread, "file read", reader);
+#else
+        reader->threads[i] = SDL_CreateThread(readerThread, "file read", reader);
+#endif
+        if (!reader->threads[i]) {
+            fprintf(stderr, "Failed to start file read thread: %s\n", SDL_GetError());
+            break;
+        }
+        reader->threadCount++;
+    }
+
+    if (reader->threadCount == 0) {
+        fileReaderDestroy(reader);
+        return nullptr;
+    }
+    return reader;
+}
+
+void fileReaderDestroy(fileReader* reader) {
+    if (!reader)
+        return;
+
+    SDL_LockMutex(reader->lock);
+    reader->quit = true;
+    SDL_BroadcastCondition(reader->wake);
+    SDL_UnlockMutex(reader->lock);
+
+    for (int i = 0; i < reader->threadCount; ++i)
+        SDL_WaitThread(reader->threads[i], nullptr);
+
+    // only left over if the threads never started
+    readRequest* r;
+    while ((r = popRequest(reader)))
+        finishRequest(reader, r, "reader shut down");
+
+#ifdef __linux__
+    if (reader->useUring)
+        uringTeardown(&reader->ring);
+#endif
+    SDL_DestroyCondition(reader->wake);
+    SDL_DestroyMutex(reader->lock);
+    free(reader->threads);
+    free(reader);
+}
+
+void fileReaderSubmit(fileReader* reader, const char* path, void* user) {
+    readRequest* r = calloc(1, sizeof(readRequest));
+    r->path = path;
+    r->user = user;
+
+    SDL_LockMutex(reader->lock);
+    if (reader->tail)
+        reader->tail->next = r;
+    else
+        reader->head = r;
+    reader->tail = r;
+    SDL_SignalCondition(reader->wake);
+    SDL_UnlockMutex(reader->lock);
+}
+
+const char* fileReaderBackend(const fileReader* reader) {
+#ifdef __linux__
+    if (reader->useUring)
+        return "io_uring";
+#endif
+    (void)reader;
+    return "threads";
+}
+
+bool fileEvictFromPageCache(const char* path) {
+#ifdef __linux__
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    const bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
@@ -0,0 +1,33 @@
+#ifndef FILE_READER_H
+#define FILE_READER_H
+
+#include <stddef.h>
+
+// Reads whole files in the background so the decode threads never sit in fopen/fread.
+// On Linux every submitted path goes into one io_uring (open and read as async ops,
+// through the raw syscalls, no liburing), so hundreds of reads are queued with the
+// kernel at once instead of one blocking round trip each. Where io_uring is missing
+// or blocked, a pool of plain blocking reader threads does the same job. If the ring
+// breaks mid-run, the reads it held are redone with blocking reads.
+
+// called on a reader thread once a file is read. data is the whole file, free with free,
+// nullptr if it couldn't be read (failure says why)
+typedef void (*fileReadDone)(void* context, void* user, unsigned char* data, size_t size, const char* failure);
+
+typedef struct fileReader fileReader;
+
+// threadCount is only used by the thread fallback. useUring false forces the fallback
+fileReader* fileReaderCreate(int threadCount, bool useUring, fileReadDone done, void* context);
+// finishes every read already submitted (calling done for each) before returning
+void fileReaderDestroy(fileReader* reader);
+
+void fileReaderSubmit(fileReader* reader, const char* path, void* user);
+
+// "io_uring" or "threads"
+const char* fileReaderBackend(const fileReader* reader);
+
+// drops path's pages from the OS file cache, so the next read comes from the disk.
+// false where that isn't supported
+bool fileEvictFromPageCache(const char* path);
+
+#endif //FILE_READER_H
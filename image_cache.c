@@ -0,0 +1,366 @@
+// image_cache.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define makeDir(path) _mkdir(path)
+#else
+#define makeDir(path) mkdir(path, 0755)
+#endif
+
+#include <SDL3/SDL.h>
+
+#include "image_cache.h"
+#include "stb_image.h"
+
+#define CACHE_MAGIC   0x4F514349u // "ICQO"
+#define CACHE_VERSION 1u
+#define CACHE_MAX_SIDE 16384u // larger than any texture GL will take, so a header saying more is corrupt
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t pathHash; // a different path landing on the same file name is a miss
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint32_t width, height;
+    uint64_t encodedSize;
+} cacheHeader;
+
+static char CacheDir[1024];
+static SDL_Mutex* StatsLock;
+static imageCacheStats Stats;
+
+static uint64_t hashPath(const char* path) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const unsigned char* c = (const unsigned char*)path; *c; ++c) {
+        hash ^= *c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool imageCacheEnable(const char* dir) {
+    makeDir(dir);
+    struct stat st;
+    if (stat(dir, &st) != 0 || !(st.st_mode & S_IFDIR)) {
+        fprintf(stderr, "Image cache directory '%s' could not be created\n", dir);
+        return false;
+    }
+    if (!StatsLock)
+        StatsLock = SDL_CreateMutex();
+    snprintf(CacheDir, sizeof(CacheDir), "%s", dir);
+    return true;
+}
+
+bool imageCacheEnabled(void) {
+    return CacheDir[0] != '\0';
+}
+
+void imageCacheGetStats(imageCacheStats* stats) {
+    SDL_LockMutex(StatsLock);
+    *stats = Stats;
+    SDL_UnlockMutex(StatsLock);
+}
+
+// ---- QOI style codec ----
+// same ops as QOI: a 64 entry table of recent colours, small diffs against the
+// previous pixel, runs, and literal RGB / RGBA as the fallback. no header or padding,
+// the cache header carries the size
+
+enum {
+    QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF  = 0x40,
+    QOI_OP_LUMA  = 0x80,
+    QOI_OP_RUN   = 0xc0,
+    QOI_OP_RGB   = 0xfe,
+    QOI_OP_RGBA  = 0xff,
+};
+
+static int qoiHash(const unsigned char* p) {
+    return (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) & 63;
+}
+
+size_t imageQoiMaxSize(const size_t pixelCount) {
+    return pixelCount * 5;
+}
+
+size_t imageQoiEncode(const unsigned char* rgba, const size_t pixelCount, unsigned char* out) {
+    unsigned char seen[64][4] = { 0 };
+    unsigned char prev[4] = { 0, 0, 0, 255 };
+    size_t o = 0;
+    int run = 0;
+
+    for (size_t i = 0; i < pixelCount; ++i) {
+        const unsigned char* p = rgba + i * 4;
+        if (memcmp(p, prev, 4) == 0) {
+            if (++run == 62) {
+                out[o++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run) {
+            out[o++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        const int h = qoiHash(p);
+        if (memcmp(seen[h], p, 4) == 0) {
+            out[o++] = (unsigned char)(QOI_OP_INDEX | h);
+        } else if (p[3] == prev[3]) {
+            const int dr = (signed char)(p[0] - prev[0]);
+            const int dg = (signed char)(p[1] - prev[1]);
+            const int db = (signed char)(p[2] - prev[2]);
+            const int drg = dr - dg, dbg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                out[o++] = (unsigned char)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                out[o++] = (unsigned char)(QOI_OP_LUMA | (dg + 32));
+                out[o++] = (unsigned char)((drg + 8) << 4 | (dbg + 8));
+            } else {
+                out[o++] = QOI_OP_RGB;
+                memcpy(out + o, p, 3);
+                o += 3;
+            }
+        } else {
+            out[o++] = QOI_OP_RGBA;
+            memcpy(out + o, p, 4);
+            o += 4;
+        }
+        memcpy(seen[h], p, 4);
+        memcpy(prev, p, 4);
+    }
+    if (run)
+        out[o++] = (unsigned char)(QOI_OP_RUN | (run - 1));
+    return o;
+}
+
+bool imageQoiDecode(const unsigned char* data, const size_t size, unsigned char* rgba, const size_t pixelCount) {
+    unsigned char seen[64][4] = { 0 };
+    unsigned char px[4] = { 0, 0, 0, 255 };
+    size_t o = 0, i = 0;
+
+    while (i < pixelCount) {
+        if (o >= size)
+            return false;
+        const unsigned char op = data[o++];
+        if (op == QOI_OP_RGB || op == QOI_OP_RGBA) {
+            const size_t n = op == QOI_OP_RGB ? 3 : 4;
+            if (o + n > size)
+                return false;
+            memcpy(px, data + o, n);
+            o += n;
+        } else if ((op & 0xc0) == QOI_OP_INDEX) {
+            memcpy(px, seen[op], 4);
+        } else if ((op & 0xc0) == QOI_OP_DIFF) {
+            px[0] += (unsigned char)((op >> 4 & 3) - 2);
+            px[1] += (unsigned char)((op >> 2 & 3) - 2);
+            px[2] += (unsigned char)((op & 3) - 2);
+        } else if ((op & 0xc0) == QOI_OP_LUMA) {
+            if (o >= size)
+                return false;
+            const int dg = (op & 63) - 32;
+            const unsigned char b = data[o++];
+            px[0] += (unsigned char)(dg + (b >> 4) - 8);
+            px[1] += (unsigned char)dg;
+            px[2] += (unsigned char)(dg + (b & 15) - 8);
+        } else {
+            // a run repeats the previous pixel, which is already in the table
+            size_t run = (size_t)(op & 63) + 1;
+            if (run > pixelCount - i)
+                return false;
+            for (; run > 0; --run, ++i)
+                memcpy(rgba + i * 4, px, 4);
+            continue;
+        }
+        memcpy(seen[qoiHash(px)], px, 4);
+        memcpy(rgba + i * 4, px, 4);
+        i++;
+    }
+    return true;
+}
+
+// ---- cache files ----
+
+static void cacheFilePath(char* out, const size_t outc, const uint64_t pathHash) {
+    snprintf(out, outc, "%s/%016llx.qoi", CacheDir, (unsigned long long)pathHash);
+}
+
+// a cache file's bytes, nullptr unless they hold want's entry. the header comes off the disk,
+// a truncated or corrupt file is just a miss
+static unsigned char* decodeEntry(const unsigned char* data, const size_t size, const cacheHeader* want, int* width, int* height,
+                                  bool* stale) {
+    cacheHeader header;
+    if (size < sizeof(header))
+        return nullptr;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.pathHash != want->pathHash)
+        return nullptr;
+
+    *stale = header.sourceMtime != want->sourceMtime || header.sourceSize != want->sourceSize;
+    const size_t count = (size_t)header.width * header.height;
+    const bool sane = header.width > 0 && header.width <= CACHE_MAX_SIDE && header.height > 0 &&
+                      header.height <= CACHE_MAX_SIDE && header.encodedSize <= imageQoiMaxSize(count) &&
+                      header.encodedSize <= size - sizeof(header);
+    unsigned char* pixels = *stale || !sane ? nullptr : malloc(count * 4);
+    if (pixels && !imageQoiDecode(data + sizeof(header), header.encodedSize, pixels, count)) {
+        free(pixels);
+        pixels = nullptr;
+    }
+    if (!pixels)
+        return nullptr;
+
+    *width = (int)header.width;
+    *height = (int)header.height;
+    SDL_LockMutex(StatsLock);
+    Stats.hits++;
+    Stats.cachedBytes += sizeof(header) + header.encodedSize;
+    Stats.decodedBytes += (uint64_t)count * 4;
+    SDL_UnlockMutex(StatsLock);
+    return pixels;
+}
+
+static unsigned char* readEntry(const char* file, const cacheHeader* want, int* width, int* height, bool* stale) {
+    FILE* f = fopen(file, "rb");
+    if (!f)
+        return nullptr;
+
+    unsigned char* data = nullptr;
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc((size_t)size);
+        if (data && fread(data, 1, (size_t)size, f) != (size_t)size) {
+            free(data);
+            data = nullptr;
+        }
+    }
+    fclose(f);
+
+    unsigned char* pixels = data ? decodeEntry(data, (size_t)size, want, width, height, stale) : nullptr;
+    free(data);
+    return pixels;
+}
+
+static void countMiss(const bool stale) {
+    SDL_LockMutex(StatsLock);
+    if (stale)
+        Stats.stale++;
+    else
+        Stats.misses++;
+    SDL_UnlockMutex(StatsLock);
+}
+
+static void writeEntry(const char* file, cacheHeader* header, const unsigned char* pixels) {
+    const size_t count = (size_t)header->width * header->height;
+    unsigned char* encoded = malloc(imageQoiMaxSize(count) + 1);
+    header->encodedSize = imageQoiEncode(pixels, count, encoded);
+
+    // written aside and renamed over, so other threads or runs never read half a file
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.%llx.tmp", file, (unsigned long long)SDL_GetCurrentThreadID());
+    FILE* f = fopen(tmp, "wb");
+    bool ok = f != nullptr;
+    ok = ok && fwrite(header, sizeof(*header), 1, f) == 1;
+    ok = ok && fwrite(encoded, 1, header->encodedSize, f) == header->encodedSize;
+    if (f)
+        ok = fclose(f) == 0 && ok;
+    free(encoded);
+
+    if (ok) {
+        remove(file);
+        ok = rename(tmp, file) == 0;
+    }
+    if (!ok)
+        remove(tmp);
+}
+
+// fills in the key for path's current version, false if it can't be cached
+static bool cacheKey(const char* path, cacheHeader* header, char* file, const size_t filec) {
+    struct stat st;
+    if (!imageCacheEnabled() || stat(path, &st) != 0)
+        return false;
+
+    *header = (cacheHeader){
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .pathHash = hashPath(path),
+        .sourceMtime = (int64_t)st.st_mtime,
+        .sourceSize = (uint64_t)st.st_size,
+    };
+    cacheFilePath(file, filec, header->pathHash);
+    return true;
+}
+
+static unsigned char* findEntry(const char* path, int* width, int* height) {
+    cacheHeader header;
+    char file[1024];
+    if (!cacheKey(path, &header, file, sizeof(file)))
+        return nullptr;
+
+    bool stale = false;
+    unsigned char* pixels = readEntry(file, &header, width, height, &stale);
+    if (!pixels)
+        countMiss(stale);
+    return pixels;
+}
+
+bool imageCacheFile(const char* path, char* file, const size_t filec) {
+    if (!imageCacheEnabled())
+        return false;
+    cacheFilePath(file, filec, hashPath(path));
+    return true;
+}
+
+unsigned char* imageCacheRead(const char* path, const unsigned char* data, const size_t size, int* width, int* height) {
+    cacheHeader header;
+    char file[1024];
+    if (!cacheKey(path, &header, file, sizeof(file)))
+        return nullptr;
+
+    bool stale = false;
+    unsigned char* pixels = data ? decodeEntry(data, size, &header, width, height, &stale) : nullptr;
+    if (!pixels)
+        countMiss(stale);
+    return pixels;
+}
+
+static void storeEntry(const char* path, const unsigned char* pixels, const int width, const int height) {
+    cacheHeader header;
+    char file[1024];
+    if (!cacheKey(path, &header, file, sizeof(file)))
+        return;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    writeEntry(file, &header, pixels);
+}
+
+unsigned char* imageCacheDecode(const char* path, const unsigned char* data, const size_t size, int* width, int* height,
+                                const char** failure) {
+    int n;
+    unsigned char* pixels = stbi_load_from_memory(data, (int)size, width, height, &n, 4);
+    if (!pixels) {
+        *failure = stbi_failure_reason();
+        return nullptr;
+    }
+    storeEntry(path, pixels, *width, *height);
+    return pixels;
+}
+
+unsigned char* imageCacheLoad(const char* path, int* width, int* height, const char** failure) {
+    unsigned char* pixels = findEntry(path, width, height);
+    if (pixels)
+        return pixels;
+
+    int n;
+    pixels = stbi_load(path, width, height, &n, 4);
+    if (!pixels) {
+        *failure = stbi_failure_reason();
+        return nullptr;
+    }
+    storeEntry(path, pixels, *width, *height);
+    return pixels;
+}
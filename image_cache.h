@@ -0,0 +1,48 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On-disk cache of decoded images, so later runs skip inflating PNGs. Each source
+// gets one file in the cache directory, named after its path hash, holding the
+// RGBA8 that stbi_load produced (untrimmed, straight alpha) compressed with a QOI
+// style byte stream, which decodes several times faster than PNG. The file header
+// records the source's size and mtime, a changed source is decoded again and its
+// entry rewritten. Safe to call from any number of decode threads.
+
+// turns the cache on for imageCacheLoad. creates dir if it doesn't exist
+bool imageCacheEnable(const char* dir);
+bool imageCacheEnabled(void);
+
+// decoded RGBA8 of path like stbi_load(path, w, h, nullptr, 4), free with stbi_image_free.
+// nullptr on failure with *failure set
+unsigned char* imageCacheLoad(const char* path, int* width, int* height, const char** failure);
+
+// the pieces of imageCacheLoad, for callers that read the files themselves.
+// imageCacheFile names the cache file that may hold path's pixels, false with the cache off.
+// imageCacheRead takes that file's bytes (nullptr if it couldn't be read) and returns the pixels,
+// or nullptr on a miss. it stats path to tell whether the entry is current, nothing more.
+// imageCacheDecode runs stbi_load_from_memory on the image's own bytes and stores the result for next time
+bool imageCacheFile(const char* path, char* file, size_t filec);
+unsigned char* imageCacheRead(const char* path, const unsigned char* data, size_t size, int* width, int* height);
+unsigned char* imageCacheDecode(const char* path, const unsigned char* data, size_t size, int* width, int* height,
+                                const char** failure);
+
+typedef struct {
+    size_t hits;
+    size_t misses; // no entry yet
+    size_t stale;  // entry for an older version of the source
+    uint64_t cachedBytes, decodedBytes; // read from cache files, and the RGBA8 they expanded to
+} imageCacheStats;
+
+void imageCacheGetStats(imageCacheStats* stats);
+
+// QOI style codec the cache files use, exposed for benchmarking.
+// out needs imageQoiMaxSize bytes, returns the bytes written
+size_t imageQoiMaxSize(size_t pixelCount);
+size_t imageQoiEncode(const unsigned char* rgba, size_t pixelCount, unsigned char* out);
+// false if data runs out before pixelCount pixels
+bool imageQoiDecode(const unsigned char* data, size_t size, unsigned char* rgba, size_t pixelCount);
+
+#endif //IMAGE_CACHE_H
@@ -0,0 +1,150 @@
+// image_manifest.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "image_manifest.h"
+#include "texture_pack.h"
+
+// entries hold raw pixelLayout values. when this fails, bump MANIFEST_VERSION and the count here
+static_assert(PIXEL_LAYOUT_COUNT == 11, "pixelLayout changed, manifests on disk need a new MANIFEST_VERSION");
+
+struct imageManifest {
+    manifestHeader header;
+    manifestEntry* entries;
+    bool* stale; // source changed since the manifest was written
+};
+
+static void opaqueBounds(const unsigned char* rgba, const int width, const int height, manifestEntry* entry) {
+    int minX = width, minY = height, maxX = -1, maxY = -1;
+    for (int row = 0; row < height; ++row) {
+        const unsigned char* line = rgba + (size_t)row * width * 4;
+        for (int col = 0; col < width; ++col) {
+            if (line[col * 4 + 3] != 255)
+                continue;
+            if (minX > col) minX = col;
+            if (maxX < col) maxX = col;
+            if (minY > row) minY = row;
+            maxY = row;
+        }
+    }
+    if (maxX < 0)
+        return;
+    entry->opaqueX = (uint32_t)minX;
+    entry->opaqueY = (uint32_t)minY;
+    entry->opaqueWidth = (uint32_t)(maxX - minX + 1);
+    entry->opaqueHeight = (uint32_t)(maxY - minY + 1);
+}
+
+void imageManifestDescribe(const unsigned char* rgba, const int width, const int height, manifestEntry* entry) {
+    *entry = (manifestEntry){
+        .contentHash = imageHash(rgba, (size_t)width * height * 4),
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+    };
+    opaqueBounds(rgba, width, height, entry);
+
+    int x, y, w, h;
+    imageTrimBounds(rgba, width, height, &x, &y, &w, &h);
+    entry->trimX = (uint32_t)x;
+    entry->trimY = (uint32_t)y;
+    entry->trimWidth = (uint32_t)w;
+    entry->trimHeight = (uint32_t)h;
+
+    // channel usage is of what a trimmed load uploads, before any lod halving
+    const size_t count = (size_t)w * h;
+    unsigned char* trimmed = malloc(count * 4);
+    for (int row = 0; row < h; ++row)
+        memcpy(trimmed + (size_t)row * w * 4, rgba + ((size_t)(y + row) * width + x) * 4, (size_t)w * 4);
+
+    unsigned char palette[PALETTE_BYTES];
+    entry->layout = (uint32_t)imageNarrowestLayout(trimmed, count, false);
+    entry->colors = (uint32_t)imageBuildPalette(trimmed, count, palette);
+    imagePremultiply(trimmed, count);
+    entry->premultipliedLayout = (uint32_t)imageNarrowestLayout(trimmed, count, false);
+    entry->premultipliedColors = (uint32_t)imageBuildPalette(trimmed, count, palette);
+    free(trimmed);
+}
+
+bool imageManifestWrite(const char* path, const manifestEntry* entries, const size_t count) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE* f = fopen(tmp, "wb");
+    if (!f)
+        return false;
+    const manifestHeader header = { MANIFEST_MAGIC, MANIFEST_VERSION, (uint32_t)count, 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(entries, sizeof(manifestEntry), count, f) == count;
+    ok = fclose(f) == 0 && ok;
+
+    remove(path);
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok)
+        remove(tmp);
+    return ok;
+}
+
+imageManifest* imageManifestOpen(const char* path, const char** paths, const size_t count) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return nullptr;
+
+    imageManifest* manifest = calloc(1, sizeof(imageManifest));
+    const char* problem = nullptr;
+    if (fread(&manifest->header, sizeof(manifestHeader), 1, f) != 1 || manifest->header.magic != MANIFEST_MAGIC)
+        problem = "not a manifest";
+    else if (manifest->header.version != MANIFEST_VERSION)
+        problem = "unsupported version";
+    else if (manifest->header.count != count)
+        problem = "lists a different number of images";
+
+    if (!problem) {
+        manifest->entries = malloc(sizeof(manifestEntry) * (count ? count : 1));
+        if (fread(manifest->entries, sizeof(manifestEntry), count, f) != count)
+            problem = "truncated";
+    }
+    for (size_t i = 0; !problem && i < count; ++i) {
+        const manifestEntry* e = &manifest->entries[i];
+        if (e->pathHash != texturePackHashPath(paths[i]))
+            problem = "lists different images";
+        else if (e->layout >= PIXEL_LAYOUT_COUNT || e->premultipliedLayout >= PIXEL_LAYOUT_COUNT)
+            problem = "damaged";
+    }
+    fclose(f);
+
+    if (problem) {
+        fprintf(stderr, "Ignoring manifest '%s': %s\n", path, problem);
+        imageManifestClose(manifest);
+        return nullptr;
+    }
+
+    // an edited asset would otherwise only show up as a misprediction once decoded, after its
+    // (possibly immutable) storage was already allocated at the wrong size
+    manifest->stale = calloc(count ? count : 1, sizeof(bool));
+    size_t stale = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const manifestEntry* e = &manifest->entries[i];
+        struct stat st;
+        manifest->stale[i] = stat(paths[i], &st) != 0 || (int64_t)st.st_mtime != e->sourceMtime ||
+                             (uint64_t)st.st_size != e->sourceSize;
+        stale += manifest->stale[i];
+    }
+    if (stale)
+        fprintf(stderr, "Manifest '%s': %zu of %zu images changed since it was written, they are sized once decoded\n",
+                path, stale, count);
+    return manifest;
+}
+
+void imageManifestClose(imageManifest* manifest) {
+    if (!manifest)
+        return;
+    free(manifest->entries);
+    free(manifest->stale);
+    free(manifest);
+}
+
+const manifestEntry* imageManifestEntry(const imageManifest* manifest, const size_t index) {
+    return manifest->stale[index] ? nullptr : &manifest->entries[index];
+}
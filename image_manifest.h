@@ -0,0 +1,56 @@
+#ifndef IMAGE_MANIFEST_H
+#define IMAGE_MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image_ops.h"
+
+// What is known about every images[] entry without decoding it, generated by
+// asset_cooker --manifest. Layout (native little-endian):
+//   manifestHeader
+//   manifestEntry[count]   one per images[] entry, same order
+// Sizes, trim rects and channel usage let textures be allocated and budgeted
+// before the first PNG is decoded.
+
+#define MANIFEST_MAGIC   0x4E414D53u // "SMAN"
+#define MANIFEST_VERSION 1u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+} manifestHeader;
+
+typedef struct {
+    uint64_t pathHash;    // texturePackHashPath of the source path
+    uint64_t contentHash; // imageHash of the decoded RGBA8, equal images have equal hashes
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint32_t width, height;
+    uint32_t trimX, trimY, trimWidth, trimHeight; // imageTrimBounds
+    uint32_t opaqueX, opaqueY, opaqueWidth, opaqueHeight; // bounds of the alpha == 255 texels, 0 x 0 if none
+    // channel usage of the trimmed rect: imageNarrowestLayout (lossless) and imageBuildPalette's
+    // colour count (0 for more than 256), with straight and with premultiplied alpha. layouts are
+    // stored as their pixelLayout value, so changing that enum needs a new MANIFEST_VERSION
+    uint32_t layout, premultipliedLayout;
+    uint32_t colors, premultipliedColors;
+} manifestEntry;
+
+// fills in everything but pathHash and the source stats from decoded RGBA8
+void imageManifestDescribe(const unsigned char* rgba, int width, int height, manifestEntry* entry);
+
+bool imageManifestWrite(const char* path, const manifestEntry* entries, size_t count);
+
+typedef struct imageManifest imageManifest;
+
+// nullptr if the file is missing, damaged, or lists other images than paths. every source
+// is stat'ed, entries whose file changed size or mtime since are dropped
+imageManifest* imageManifestOpen(const char* path, const char** paths, size_t count);
+void imageManifestClose(imageManifest* manifest);
+
+// nullptr for a dropped entry, that image's size and layout are only known once it is decoded
+const manifestEntry* imageManifestEntry(const imageManifest* manifest, size_t index);
+
+#endif //IMAGE_MANIFEST_H
@@ -0,0 +1,460 @@
+// image_ops.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMAGE_OPS_SSE2 1
+#endif
+// AVX2 is picked at runtime, the build itself only assumes SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define IMAGE_OPS_AVX2 1
+#endif
+
+#include "image_ops.h"
+
+void imagePremultiplyScalar(unsigned char* rgba, const size_t pixelCount) {
+    for (size_t i = 0; i < pixelCount; ++i) {
+        unsigned char* p = rgba + i * 4;
+        const unsigned a = p[3];
+        // round(x * a / 255) without a divide
+        for (int c = 0; c < 3; ++c) {
+            const unsigned v = p[c] * a + 128;
+            p[c] = (unsigned char)((v + (v >> 8)) >> 8);
+        }
+    }
+}
+
+// the vector versions widen to 16 bits and use the same rounding, c * a + 128 and the
+// (v + (v >> 8)) >> 8 divide never leave 16 bits. alpha lanes are multiplied by 255,
+// which gives alpha back unchanged
+#ifdef IMAGE_OPS_SSE2
+static __m128i premultiplyHalf(const __m128i px, const __m128i alphaMask) {
+    __m128i alpha = _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_or_si128(_mm_andnot_si128(alphaMask, alpha), _mm_and_si128(alphaMask, _mm_set1_epi16(255)));
+
+    const __m128i v = _mm_add_epi16(_mm_mullo_epi16(px, alpha), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+static size_t premultiplySSE2(unsigned char* rgba, const size_t pixelCount) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    size_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4) {
+        __m128i* p = (__m128i*)(rgba + i * 4);
+        const __m128i px = _mm_loadu_si128(p);
+        const __m128i lo = premultiplyHalf(_mm_unpacklo_epi8(px, zero), alphaMask);
+        const __m128i hi = premultiplyHalf(_mm_unpackhi_epi8(px, zero), alphaMask);
+        _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+#endif
+
+#ifdef IMAGE_OPS_AVX2
+__attribute__((target("avx2")))
+static __m256i premultiplyHalfAVX2(const __m256i px, const __m256i alphaMask) {
+    __m256i alpha = _mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_blendv_epi8(alpha, _mm256_set1_epi16(255), alphaMask);
+
+    const __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(px, alpha), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)), 8);
+}
+
+// unpack and pack both work per 128-bit lane, so pixel order survives the round trip
+__attribute__((target("avx2")))
+static size_t premultiplyAVX2(unsigned char* rgba, const size_t pixelCount) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+    size_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8) {
+        __m256i* p = (__m256i*)(rgba + i * 4);
+        const __m256i px = _mm256_loadu_si256(p);
+        const __m256i lo = premultiplyHalfAVX2(_mm256_unpacklo_epi8(px, zero), alphaMask);
+        const __m256i hi = premultiplyHalfAVX2(_mm256_unpackhi_epi8(px, zero), alphaMask);
+        _mm256_storeu_si256(p, _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+#endif
+
+const char* imagePremultiplyPath(void) {
+#ifdef IMAGE_OPS_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return "avx2";
+#endif
+#ifdef IMAGE_OPS_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void imagePremultiply(unsigned char* rgba, const size_t pixelCount) {
+    size_t done = 0;
+#ifdef IMAGE_OPS_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        done = premultiplyAVX2(rgba, pixelCount);
+#endif
+#ifdef IMAGE_OPS_SSE2
+    done += premultiplySSE2(rgba + done * 4, pixelCount - done);
+#endif
+    imagePremultiplyScalar(rgba + done * 4, pixelCount - done);
+}
+
+void imageTrimBounds(const unsigned char* rgba, const int width, const int height, int* x, int* y, int* w, int* h) {
+    int minX = width, minY = height, maxX = -1, maxY = -1;
+
+    for (int row = 0; row < height; ++row) {
+        const unsigned char* line = rgba + (size_t)row * width * 4;
+        int first = -1, last = -1;
+        for (int col = 0; col < width; ++col) {
+            if (line[col * 4 + 3]) {
+                if (first < 0)
+                    first = col;
+                last = col;
+            }
+        }
+        if (first < 0)
+            continue;
+
+        if (minY > row) minY = row;
+        maxY = row;
+        if (minX > first) minX = first;
+        if (maxX < last) maxX = last;
+    }
+
+    if (maxX < 0) {
+        *x = *y = 0;
+        *w = *h = 1;
+        return;
+    }
+
+    minX = minX > 0 ? minX - 1 : 0;
+    minY = minY > 0 ? minY - 1 : 0;
+    maxX = maxX < width - 1 ? maxX + 1 : width - 1;
+    maxY = maxY < height - 1 ? maxY + 1 : height - 1;
+
+    *x = minX;
+    *y = minY;
+    *w = maxX - minX + 1;
+    *h = maxY - minY + 1;
+}
+
+void imageCropInPlace(unsigned char* rgba, const int width, const int x, const int y, const int w, const int h) {
+    // every destination row starts at or before its source row, so front to back is safe
+    for (int row = 0; row < h; ++row)
+        memmove(rgba + (size_t)row * w * 4, rgba + ((size_t)(y + row) * width + x) * 4, (size_t)w * 4);
+}
+
+int imageMipCount(int width, int height) {
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        levels++;
+    }
+    return levels;
+}
+
+void imageDownsample(const unsigned char* src, const int width, const int height, unsigned char* dst) {
+    const int dw = width > 1 ? width / 2 : 1;
+    const int dh = height > 1 ? height / 2 : 1;
+
+    for (int y = 0; y < dh; ++y) {
+        const int y0 = y * 2 < height ? y * 2 : height - 1;
+        const int y1 = y * 2 + 1 < height ? y * 2 + 1 : y0;
+        for (int x = 0; x < dw; ++x) {
+            const int x0 = x * 2 < width ? x * 2 : width - 1;
+            const int x1 = x * 2 + 1 < width ? x * 2 + 1 : x0;
+
+            const unsigned char* a = src + ((size_t)y0 * width + x0) * 4;
+            const unsigned char* b = src + ((size_t)y0 * width + x1) * 4;
+            const unsigned char* c = src + ((size_t)y1 * width + x0) * 4;
+            const unsigned char* d = src + ((size_t)y1 * width + x1) * 4;
+            unsigned char* out = dst + ((size_t)y * dw + x) * 4;
+            for (int ch = 0; ch < 4; ++ch)
+                out[ch] = (unsigned char)((a[ch] + b[ch] + c[ch] + d[ch] + 2) / 4);
+        }
+    }
+}
+
+// sRGB decode table and the linear midpoints between neighbouring sRGB codes.
+// per thread so the cooker workers never race on the first fill
+static _Thread_local float srgbToLinear[256];
+static _Thread_local float srgbThresholds[255];
+static _Thread_local bool srgbTablesReady;
+
+static float decodeSRGB(const float v) {
+    return v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static void initSRGBTables(void) {
+    for (int i = 0; i < 256; ++i)
+        srgbToLinear[i] = decodeSRGB(i / 255.0f);
+    for (int i = 0; i < 255; ++i)
+        srgbThresholds[i] = decodeSRGB((i + 0.5f) / 255.0f);
+    srgbTablesReady = true;
+}
+
+// nearest sRGB code, exact against the decode table
+static unsigned char encodeSRGB(const float linear) {
+    int lo = 0, hi = 255;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (linear < srgbThresholds[mid])
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return (unsigned char)lo;
+}
+
+void imageDownsampleSRGB(const unsigned char* src, const int width, const int height, unsigned char* dst) {
+    if (!srgbTablesReady)
+        initSRGBTables();
+
+    const int dw = width > 1 ? width / 2 : 1;
+    const int dh = height > 1 ? height / 2 : 1;
+
+    for (int y = 0; y < dh; ++y) {
+        const int y0 = y * 2 < height ? y * 2 : height - 1;
+        const int y1 = y * 2 + 1 < height ? y * 2 + 1 : y0;
+        for (int x = 0; x < dw; ++x) {
+            const int x0 = x * 2 < width ? x * 2 : width - 1;
+            const int x1 = x * 2 + 1 < width ? x * 2 + 1 : x0;
+
+            const unsigned char* texels[4] = {
+                src + ((size_t)y0 * width + x0) * 4,
+                src + ((size_t)y0 * width + x1) * 4,
+                src + ((size_t)y1 * width + x0) * 4,
+                src + ((size_t)y1 * width + x1) * 4,
+            };
+
+            // linear rgb scaled by alpha, plus alpha, summed over the 2x2 footprint
+            float sum[4], plain[4];
+#ifdef IMAGE_OPS_SSE2
+            __m128 weighted = _mm_setzero_ps(), unweighted = _mm_setzero_ps();
+            for (int i = 0; i < 4; ++i) {
+                const unsigned char* t = texels[i];
+                const __m128 lin = _mm_set_ps(1.0f, srgbToLinear[t[2]], srgbToLinear[t[1]], srgbToLinear[t[0]]);
+                weighted = _mm_add_ps(weighted, _mm_mul_ps(lin, _mm_set1_ps(t[3] / 255.0f)));
+                unweighted = _mm_add_ps(unweighted, lin);
+            }
+            _mm_storeu_ps(sum, weighted);
+            _mm_storeu_ps(plain, unweighted);
+#else
+            for (int c = 0; c < 4; ++c)
+                sum[c] = plain[c] = 0.0f;
+            for (int i = 0; i < 4; ++i) {
+                const unsigned char* t = texels[i];
+                const float a = t[3] / 255.0f;
+                for (int c = 0; c < 3; ++c) {
+                    sum[c] += srgbToLinear[t[c]] * a;
+                    plain[c] += srgbToLinear[t[c]];
+                }
+                sum[3] += a;
+            }
+#endif
+
+            unsigned char* out = dst + ((size_t)y * dw + x) * 4;
+            // a fully transparent footprint keeps its plain average so later levels still have a colour to blend to
+            for (int c = 0; c < 3; ++c)
+                out[c] = encodeSRGB(sum[3] > 0.0f ? sum[c] / sum[3] : plain[c] / 4.0f);
+            out[3] = (unsigned char)(sum[3] * (255.0f / 4.0f) + 0.5f);
+        }
+    }
+}
+
+size_t imageMipChainSize(int width, int height, const int levels) {
+    size_t size = 0;
+    for (int i = 0; i < levels; ++i) {
+        size += (size_t)width * height * 4;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t imageHash(const void* data, const size_t size) {
+    const unsigned char* bytes = data;
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ mix64(word)) * 0x100000001b3ull;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    return mix64(hash ^ mix64(tail));
+}
+
+int pixelLayoutSize(const pixelLayout layout) {
+    switch (layout) {
+        case PIXEL_RGBA8: return 4;
+        case PIXEL_RGB8: return 3;
+        case PIXEL_RGB565:
+        case PIXEL_GRAY_ALPHA: return 2;
+        default: return 1;
+    }
+}
+
+const char* pixelLayoutName(const pixelLayout layout) {
+    static const char* names[PIXEL_LAYOUT_COUNT] = {
+        "RGBA8", "RGB8", "RGB565", "RG8 gray+alpha", "R8 gray", "R8 alpha (black)", "R8 alpha (white)", "R8 alpha (white, premultiplied)",
+        "R8 indexed", "BC3", "BC7",
+    };
+    return layout < PIXEL_LAYOUT_COUNT ? names[layout] : "?";
+}
+
+bool pixelLayoutCompressed(const pixelLayout layout) {
+    return layout == PIXEL_BC3 || layout == PIXEL_BC7;
+}
+
+size_t pixelLayoutLevelSize(const pixelLayout layout, const int width, const int height) {
+    if (pixelLayoutCompressed(layout))
+        return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * 16;
+    return (size_t)width * height * pixelLayoutSize(layout);
+}
+
+size_t pixelLayoutChainSize(const pixelLayout layout, int width, int height, const int levels) {
+    size_t size = 0;
+    for (int i = 0; i < levels; ++i) {
+        size += pixelLayoutLevelSize(layout, width, height);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+pixelLayout imageNarrowestLayout(const unsigned char* rgba, const size_t pixelCount, const bool allowLossy) {
+    bool opaque = true, gray = true, black = true, white = true, rgbIsAlpha = true;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        const unsigned char* p = rgba + i * 4;
+        opaque &= p[3] == 255;
+        gray &= p[0] == p[1] && p[1] == p[2];
+        black &= (p[0] | p[1] | p[2]) == 0;
+        white &= (p[0] & p[1] & p[2]) == 255;
+        rgbIsAlpha &= p[0] == p[3] && p[1] == p[3] && p[2] == p[3];
+        if (!opaque && !gray)
+            return PIXEL_RGBA8;
+    }
+
+    if (opaque)
+        return gray ? PIXEL_GRAY : allowLossy ? PIXEL_RGB565 : PIXEL_RGB8;
+    if (black)
+        return PIXEL_ALPHA_BLACK;
+    if (white)
+        return PIXEL_ALPHA_WHITE;
+    if (rgbIsAlpha)
+        return PIXEL_ALPHA_WHITE_PREMULTIPLIED;
+    return PIXEL_GRAY_ALPHA;
+}
+
+// open addressed colour -> palette index, twice the palette size keeps probes short
+#define PALETTE_SLOTS 512
+
+typedef struct {
+    uint32_t color;
+    int index; // -1 for an empty slot
+} paletteSlot;
+
+static int paletteFind(paletteSlot* slots, const uint32_t color) {
+    uint32_t slot = (color * 0x9e3779b1u) >> 23;
+    while (slots[slot].index >= 0 && slots[slot].color != color)
+        slot = (slot + 1) & (PALETTE_SLOTS - 1);
+    return (int)slot;
+}
+
+int imageBuildPalette(const unsigned char* rgba, const size_t pixelCount, unsigned char palette[256 * 4]) {
+    paletteSlot slots[PALETTE_SLOTS];
+    for (int i = 0; i < PALETTE_SLOTS; ++i)
+        slots[i].index = -1;
+
+    int colors = 0;
+    uint32_t last = 0;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        uint32_t color;
+        memcpy(&color, rgba + i * 4, 4);
+        // runs of one colour are the common case in flat art
+        if (colors && color == last)
+            continue;
+        last = color;
+
+        const int slot = paletteFind(slots, color);
+        if (slots[slot].index >= 0)
+            continue;
+        if (colors == 256)
+            return 0;
+        slots[slot] = (paletteSlot){ color, colors };
+        memcpy(palette + colors * 4, &color, 4);
+        colors++;
+    }
+    return colors;
+}
+
+void imageApplyPalette(unsigned char* rgba, const size_t pixelCount, const unsigned char* palette, const int colors) {
+    paletteSlot slots[PALETTE_SLOTS];
+    for (int i = 0; i < PALETTE_SLOTS; ++i)
+        slots[i].index = -1;
+    for (int i = 0; i < colors; ++i) {
+        uint32_t color;
+        memcpy(&color, palette + i * 4, 4);
+        slots[paletteFind(slots, color)] = (paletteSlot){ color, i };
+    }
+
+    // one byte out per four in, so writing front to back never passes the reads
+    for (size_t i = 0; i < pixelCount; ++i) {
+        uint32_t color;
+        memcpy(&color, rgba + i * 4, 4);
+        rgba[i] = (unsigned char)slots[paletteFind(slots, color)].index;
+    }
+}
+
+void imageConvertLayout(unsigned char* rgba, const size_t pixelCount, const pixelLayout layout) {
+    // every layout is at most 4 bytes a pixel, so writing front to back never passes the reads
+    for (size_t i = 0; i < pixelCount; ++i) {
+        const unsigned char* p = rgba + i * 4;
+        const unsigned char r = p[0], g = p[1], b = p[2], a = p[3];
+        switch (layout) {
+            case PIXEL_RGBA8:
+                return;
+            case PIXEL_RGB8:
+                rgba[i * 3] = r;
+                rgba[i * 3 + 1] = g;
+                rgba[i * 3 + 2] = b;
+                break;
+            case PIXEL_RGB565: {
+                const uint16_t v = (uint16_t)((r * 31 + 127) / 255 << 11 | (g * 63 + 127) / 255 << 5 | (b * 31 + 127) / 255);
+                memcpy(rgba + i * 2, &v, sizeof(v));
+                break;
+            }
+            case PIXEL_GRAY_ALPHA:
+                rgba[i * 2] = r;
+                rgba[i * 2 + 1] = a;
+                break;
+            case PIXEL_GRAY:
+                rgba[i] = r;
+                break;
+            default:
+                rgba[i] = a;
+                break;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef IMAGE_OPS_H
+#define IMAGE_OPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CPU side pixel processing shared by the runtime loader and the asset cooker.
+// Everything works on tightly packed RGBA8.
+
+// multiplies rgb by alpha, rounded. uses AVX2 or SSE2 when the CPU has them
+void imagePremultiply(unsigned char* rgba, size_t pixelCount);
+// the plain loop the vector paths must match, for benchmarks and checks
+void imagePremultiplyScalar(unsigned char* rgba, size_t pixelCount);
+// "avx2", "sse2" or "scalar", whichever imagePremultiply runs on this machine
+const char* imagePremultiplyPath(void);
+
+// smallest rect holding every pixel with alpha > 0, grown by one transparent
+// texel on each side so bilinear filtering at the edges is unchanged.
+// a fully transparent image gives a 1x1 rect at the origin
+void imageTrimBounds(const unsigned char* rgba, int width, int height, int* x, int* y, int* w, int* h);
+
+// moves the w x h rect at x, y to the front of the buffer, rows tightly packed
+void imageCropInPlace(unsigned char* rgba, int width, int x, int y, int w, int h);
+
+// number of levels down to 1x1, level 0 included
+int imageMipCount(int width, int height);
+
+// one 2x2 box filtered level. dst is max(1, width / 2) x max(1, height / 2)
+// and may be src, every output texel lands before the source texels still to be read
+void imageDownsample(const unsigned char* src, int width, int height, unsigned char* dst);
+
+// one 2x2 level for straight alpha sRGB data. colour is averaged in linear light and
+// weighted by alpha, so transparent texels neither darken edges nor bleed their colour in.
+// src and dst must not overlap
+void imageDownsampleSRGB(const unsigned char* src, int width, int height, unsigned char* dst);
+
+// bytes of a full mip chain starting at width x height
+size_t imageMipChainSize(int width, int height, int levels);
+
+uint64_t imageHash(const void* data, size_t size);
+
+// narrower ways to store an image that only uses some of its channels.
+// texture_upload maps each to a GL format and swizzle that reads back as RGBA
+typedef enum {
+    PIXEL_RGBA8,
+    PIXEL_RGB8,        // opaque
+    PIXEL_RGB565,      // opaque, lossy, only picked when asked for
+    PIXEL_GRAY_ALPHA,  // RG8, r == g == b
+    PIXEL_GRAY,        // R8, r == g == b and opaque
+    PIXEL_ALPHA_BLACK, // R8 alpha, rgb all 0
+    PIXEL_ALPHA_WHITE, // R8 alpha, rgb all 255
+    PIXEL_ALPHA_WHITE_PREMULTIPLIED, // R8 alpha, rgb == alpha
+    PIXEL_INDEXED8,    // R8 palette indices, texture.paletteID holds the colours
+    PIXEL_BC3,         // 4x4 blocks, 16 bytes each, from block_compress. only cooked packs carry these
+    PIXEL_BC7,
+    PIXEL_LAYOUT_COUNT
+} pixelLayout;
+
+// bytes per texel. block layouts report 1, use pixelLayoutLevelSize for them
+int pixelLayoutSize(pixelLayout layout);
+const char* pixelLayoutName(pixelLayout layout);
+bool pixelLayoutCompressed(pixelLayout layout);
+// bytes of one width x height level, and of a chain of levels starting there
+size_t pixelLayoutLevelSize(pixelLayout layout, int width, int height);
+size_t pixelLayoutChainSize(pixelLayout layout, int width, int height, int levels);
+
+// the smallest layout that keeps every pixel, RGB565 for opaque colour only with allowLossy
+pixelLayout imageNarrowestLayout(const unsigned char* rgba, size_t pixelCount, bool allowLossy);
+
+#define PALETTE_BYTES (256 * 4) // a full RGBA8 palette, what PIXEL_INDEXED8 costs on top of its indices
+
+// up to 256 distinct RGBA colours of the image into palette, in first seen order.
+// returns how many, or 0 when there are more
+int imageBuildPalette(const unsigned char* rgba, size_t pixelCount, unsigned char palette[256 * 4]);
+
+// rewrites RGBA8 pixels in place as PIXEL_INDEXED8, every colour must be in palette
+void imageApplyPalette(unsigned char* rgba, size_t pixelCount, const unsigned char* palette, int colors);
+
+// rewrites RGBA8 pixels in place as an uncompressed layout, tightly packed from the start of the buffer
+void imageConvertLayout(unsigned char* rgba, size_t pixelCount, pixelLayout layout);
+
+#endif //IMAGE_OPS_H
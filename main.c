@@ -1,6 +1,7 @@
 // main.c
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <glad/glad.h>
@@ -13,6 +14,26 @@
 #include "stb_image.h"
 #include "shaders.h"
 #include "image_paths.h"
+#include "decode_pool.h"
+#include "texture.h"
+#include "texture_stream.h"
+#include "texture_pack.h"
+#include "image_ops.h"
+#include "atlas.h"
+#include "texture_array.h"
+#include "texture_upload.h"
+#include "texture_cache.h"
+#include "image_cache.h"
+#include "file_reader.h"
+#include "image_manifest.h"
+#include "staging_buffer.h"
+#include "sprite_renderer.h"
+#include "ring_buffer.h"
+#include "draw_list.h"
+#include "batch_builder.h"
+#ifdef EMBEDDED_TEXTURE_PACK
+#include "embedded_pack.h"
+#endif
 
 //#define SPRITE_COUNT suki_sprites
 #define SPRITE_COUNT 360
@@ -22,16 +43,11 @@ int WINDOW_WIDTH  = 1280;
 int WINDOW_HEIGHT = 720;
 
 
-typedef struct {
-    int width, height;
-    GLuint textureID;
-} texture;
-
 typedef struct {
     float x, y;
     float rot;
     float scale;
-    texture texture;
+    const texture* texture;
 } spite;
 
 typedef struct {
@@ -41,6 +57,18 @@ typedef struct {
 } framebuffer;
 
 
+// pixel bytes the texture stream may upload per frame while assets are coming in
+#define DEFAULT_UPLOAD_BUDGET (8 * 1024 * 1024)
+// size of the persistently mapped buffer decode threads stage into with --persistent-staging
+#define DEFAULT_STAGING_BYTES (32 * 1024 * 1024)
+// per frame region of the ring buffer sprite instances, vertices and uniform blocks are written to,
+// room for --bench-sprites' largest run
+#define RING_FRAME_BYTES (8 * 1024 * 1024)
+// uniform block binding of the upscale pass' Transform
+#define TRANSFORM_BINDING 0
+// grid cell of the batch builder, in render target pixels
+#define MERGE_CELL_SIZE 32
+
 #define DEFAULT_DRAW_WIDTH 1280.0
 #define DEFAULT_DRAW_HEIGHT 720.0
 
@@ -51,6 +79,9 @@ framebuffer drawBuffer = {
     DEFAULT_DRAW_HEIGHT
 };
 float GlobalScale = 1;
+imageManifest* AssetManifest = nullptr; // sizes and channel usage of images[] ahead of decoding, if there is one
+size_t StagingBytes = 0; // see textureStreamCreate
+unsigned DecodeFlags = DECODE_TRIM | DECODE_HASH | DECODE_PREMULTIPLY | DECODE_NARROW | DECODE_PALETTE | DECODE_BATCHED_IO;
 
 
 static const char* gl_error_string(GLenum error) {
@@ -88,37 +119,652 @@ static GLuint makeShaderProgram(const GLuint frag, const GLuint vert) {
     return shaderProgram;
 }
 
-static texture* loadTextures(const char** paths, const size_t pathsc)
+static void unloadTextures(texture* tex, const size_t texc) {
+    // one call, so names shared between entries are only freed once. palette 0 is skipped by GL
+    GLuint* ids = malloc(sizeof(GLuint) * (texc ? texc * 2 : 1));
+    for (size_t i = 0; i < texc; ++i) {
+        ids[i * 2] = tex[i].textureID;
+        ids[i * 2 + 1] = tex[i].paletteID;
+    }
+    glDeleteTextures(texc * 2, ids);
+    free(ids);
+    free(tex);
+}
+
+// blocking load, used when streaming is turned off and for benchmarking. lods may be nullptr
+static texture* loadTextures(const char** paths, const size_t pathsc, const int threadCount, const int* lods)
 {
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    textureStream* stream = textureStreamCreate(paths, pathsc, threadCount, DecodeFlags, 0, lods, AssetManifest, StagingBytes);
+    if (!stream)
+        return nullptr;
+
+    while (!textureStreamFinished(stream))
+        textureStreamUpdate(stream, true);
+    CHECK_GL_ERRORS();
+
+    texture* tex = textureStreamTextures(stream);
+    const size_t failures = textureStreamFailures(stream);
+    size_t duplicates, duplicateBytes, predicted, mispredicted;
+    textureStreamDuplicates(stream, &duplicates, &duplicateBytes);
+    textureStreamPredictions(stream, &predicted, &mispredicted);
+    textureStreamDestroy(stream);
+
+    if (failures) {
+        unloadTextures(tex, pathsc);
+        return nullptr;
+    }
+
+    const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    printf("Loaded %zu textures in %.2f ms (%d decode threads, %zu duplicates sharing a texture, %.1f MiB saved)\n",
+           pathsc, ms, threadCount, duplicates, duplicateBytes / (1024.0 * 1024.0));
+    if (AssetManifest)
+        printf("  %zu uploads filled storage allocated from the manifest, %zu had to respecify it\n", predicted, mispredicted);
+    return tex;
+}
+
+// uploads straight out of the pack mapping, nothing is decoded or copied on our side.
+// with lods, the top levels of cooked mip chains are skipped
+static texture* loadTexturesFromPack(const texturePack* pack, const char** paths, const size_t pathsc, const int* lods)
+{
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    if (texturePackCount(pack) != pathsc) {
+        fprintf(stderr, "Texture pack has %zu entries, expected %zu\n", texturePackCount(pack), pathsc);
+        return nullptr;
+    }
+
     texture* tex = malloc(sizeof(texture) * pathsc);
-    GLuint* idsIDK = malloc(sizeof(GLuint) * pathsc);
-    glGenTextures(pathsc, idsIDK);
+    size_t shared = 0;
 
     for (size_t i = 0; i < pathsc; ++i) {
-        int w, h, n;
-        unsigned char* data = stbi_load(paths[i], &w, &h, &n, 4);
-        if (!data) {
-            fprintf(stderr, "Failed to load '%s': %s\n", paths[i], stbi_failure_reason());
+        const packEntry* e = texturePackEntry(pack, i);
+        const pixelLayout layout = packFormatLayout(e->format);
+        if (e->pathHash != texturePackHashPath(paths[i]) || layout == PIXEL_LAYOUT_COUNT || e->levels == 0 ||
+            e->size < pixelLayoutChainSize(layout, (int)e->width, (int)e->height, (int)e->levels)) {
+            fprintf(stderr, "Texture pack entry %zu does not match '%s', rebuild the pack\n", i, paths[i]);
+            unloadTextures(tex, i);
+            return nullptr;
+        }
+        if (!textureLayoutSupported(layout)) {
+            fprintf(stderr, "Texture pack is %s compressed but the driver can't sample it, cook it with --compress none\n",
+                    pixelLayoutName(layout));
+            unloadTextures(tex, i);
             return nullptr;
         }
 
-        glBindTexture(GL_TEXTURE_2D, idsIDK[i]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
-        tex[i].width = w;
-        tex[i].height = h;
-        tex[i].textureID = idsIDK[i];
+        tex[i] = makeTrimmedTexture((int)e->sourceWidth, (int)e->sourceHeight, 0, true,
+                                    (int)e->trimX, (int)e->trimY, (int)e->width, (int)e->height);
+        const int lod = lods ? lods[i] : 0;
+        tex[i].lod = lod < (int)e->levels ? lod : (int)e->levels - 1;
+        tex[i].levels = (int)e->levels - tex[i].lod;
+        tex[i].layout = layout;
+
+        // deduplicated entries point at the same blob, give them the same texture too
+        for (size_t j = 0; j < i && !tex[i].textureID; ++j) {
+            if (texturePackEntry(pack, j)->offset == e->offset) {
+                tex[i].textureID = tex[j].textureID;
+                tex[i].lod = tex[j].lod;
+                tex[i].levels = tex[j].levels;
+            }
+        }
+        if (tex[i].textureID) {
+            shared++;
+            continue;
+        }
 
-        stbi_image_free(data);
+        glGenTextures(1, &tex[i].textureID);
+        uploadTexture(tex[i].textureID, textureStoredWidth(&tex[i]), textureStoredHeight(&tex[i]), tex[i].levels, layout,
+                      texturePackLevel(pack, i, (uint32_t)tex[i].lod));
     }
     CHECK_GL_ERRORS();
 
-    free(idsIDK);
+    const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    printf("Loaded %zu textures from pack in %.2f ms (%zu shared)\n", pathsc, ms, shared);
     return tex;
 }
 
+// startup cost of the PNG path against the pack path, pack open time included
+static void benchmarkPack(const char** paths, const size_t pathsc, const int threadCount, const char* packPath) {
+    const double freq = (double)SDL_GetPerformanceFrequency();
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    texture* tex = loadTextures(paths, pathsc, threadCount, nullptr);
+    glFinish();
+    const double pngMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / freq;
+    if (tex)
+        unloadTextures(tex, pathsc);
+
+    start = SDL_GetPerformanceCounter();
+    texturePack* pack = texturePackOpen(packPath);
+    tex = pack ? loadTexturesFromPack(pack, paths, pathsc, nullptr) : nullptr;
+    glFinish();
+    const double packMs = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / freq;
+    if (tex)
+        unloadTextures(tex, pathsc);
+    texturePackClose(pack);
+
+    if (tex)
+        printf("Startup benchmark: png %.2f ms, pack %.2f ms (%.1fx)\n", pngMs, packMs, pngMs / packMs);
+}
+
+typedef enum {
+    UPLOAD_MUTABLE,    // glTexImage2D from client memory, the old path
+    UPLOAD_IMMUTABLE,  // glTexStorage2D + glTexSubImage2D from client memory
+    UPLOAD_PBO,        // the same through an orphaned PBO, copy included, as textureStreamUpdate does it
+    UPLOAD_PERSISTENT, // the same from a persistently mapped buffer decode threads already copied into
+    UPLOAD_MODE_COUNT
+} uploadMode;
+
+// one upload of every image, GL thread time until the GPU is done with it
+static double timeUploads(const uploadMode mode, const decodeResult* results, const size_t resultc, stagingBuffer* staging,
+                          const size_t* stagingOffsets) {
+    GLuint* ids = malloc(sizeof(GLuint) * resultc);
+    glGenTextures(resultc, ids);
+    GLuint pbo;
+    glGenBuffers(1, &pbo);
+    glFinish();
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    textureUploadSetImmutable(mode != UPLOAD_MUTABLE);
+    unsigned char* mapped = nullptr;
+    if (mode == UPLOAD_PBO) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < resultc; ++i)
+            bytes += ((size_t)results[i].width * results[i].height * pixelLayoutSize(results[i].layout) + 3) & ~(size_t)3;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        size_t offset = 0;
+        for (size_t i = 0; i < resultc && mapped; ++i) {
+            const size_t size = (size_t)results[i].width * results[i].height * pixelLayoutSize(results[i].layout);
+            memcpy(mapped + offset, results[i].pixels, size);
+            offset += (size + 3) & ~(size_t)3;
+        }
+        if (mapped && !glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+            mapped = nullptr;
+        if (!mapped)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else if (mode == UPLOAD_PERSISTENT) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBufferName(staging));
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < resultc; ++i) {
+        const decodeResult* r = &results[i];
+        const void* data = r->pixels;
+        if (mode == UPLOAD_PBO && mapped) {
+            data = (const void*)offset;
+            offset += ((size_t)r->width * r->height * pixelLayoutSize(r->layout) + 3) & ~(size_t)3;
+        } else if (mode == UPLOAD_PERSISTENT) {
+            data = (const void*)stagingOffsets[i];
+        }
+        uploadTexture(ids[i], r->width, r->height, 1, r->layout, data);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glFinish();
+    const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    glDeleteBuffers(1, &pbo);
+    glDeleteTextures(resultc, ids);
+    free(ids);
+    return ms;
+}
+
+// upload throughput of the asset set per upload path, decoded once up front. best of a few passes
+static void benchmarkUploads(const char** paths, const size_t pathsc, const int threadCount) {
+    static const char* names[UPLOAD_MODE_COUNT] = {
+        "glTexImage2D", "glTexStorage2D", "glTexStorage2D + PBO", "glTexStorage2D + persistent staging"
+    };
+    const bool immutable = textureUploadImmutable();
+
+    decodePool* pool = decodePoolCreate(threadCount, DecodeFlags);
+    if (!pool)
+        return;
+    for (size_t i = 0; i < pathsc; ++i)
+        decodePoolSubmit(pool, i, paths[i], 0);
+    decodeResult* results = malloc(sizeof(decodeResult) * pathsc);
+    size_t resultc = 0;
+    size_t bytes = 0, stagingBytes = 0;
+    while (decodePoolPop(pool, &results[resultc], true)) {
+        const decodeResult* r = &results[resultc];
+        if (!r->pixels) {
+            free(r->palette);
+            continue;
+        }
+        const size_t size = (size_t)r->width * r->height * pixelLayoutSize(r->layout);
+        bytes += size;
+        stagingBytes += (size + STAGING_CHUNK - 1) / STAGING_CHUNK * STAGING_CHUNK;
+        resultc++;
+    }
+    decodePoolDestroy(pool);
+
+    // staging is filled outside the timing, decode threads do that copy while decoding
+    stagingBuffer* staging = resultc ? stagingBufferCreate(stagingBytes) : nullptr;
+    size_t* stagingOffsets = malloc(sizeof(size_t) * (resultc ? resultc : 1));
+    for (size_t i = 0; staging && i < resultc; ++i) {
+        const decodeResult* r = &results[i];
+        const size_t size = (size_t)r->width * r->height * pixelLayoutSize(r->layout);
+        unsigned char* memory;
+        if (stagingBufferAlloc(staging, size, &stagingOffsets[i], &memory)) {
+            memcpy(memory, r->pixels, size);
+        } else {
+            stagingBufferDestroy(staging);
+            staging = nullptr;
+        }
+    }
+
+    printf("Upload benchmark: %zu images, %.1f MiB\n", resultc, bytes / (1024.0 * 1024.0));
+    for (int m = 0; m < UPLOAD_MODE_COUNT; ++m) {
+        if (m != UPLOAD_MUTABLE && !GLAD_GL_ARB_texture_storage) {
+            printf("  %-36s unsupported (no ARB_texture_storage)\n", names[m]);
+            continue;
+        }
+        if (m == UPLOAD_PERSISTENT && !staging) {
+            printf("  %-36s unsupported (no ARB_buffer_storage)\n", names[m]);
+            continue;
+        }
+        double best = 0;
+        for (int pass = 0; pass < 3; ++pass) {
+            const double ms = timeUploads((uploadMode)m, results, resultc, staging, stagingOffsets);
+            if (pass == 0 || ms < best)
+                best = ms;
+        }
+        printf("  %-36s %8.2f ms, %8.1f MiB/s\n", names[m], best, bytes / (1024.0 * 1024.0) / (best / 1000.0));
+    }
+    textureUploadSetImmutable(immutable);
+
+    stagingBufferDestroy(staging);
+    free(stagingOffsets);
+    for (size_t i = 0; i < resultc; ++i) {
+        stbi_image_free(results[i].pixels);
+        free(results[i].palette);
+    }
+    free(results);
+}
+
+// premultiply throughput of the scalar loop against the SIMD path imagePremultiply picks
+static void benchmarkPremultiply(void) {
+    const size_t pixels = 32 * 1024 * 1024;
+    unsigned char* reference = malloc(pixels * 4);
+    unsigned char* simd = malloc(pixels * 4);
+    for (size_t i = 0; i < pixels * 4; ++i)
+        reference[i] = (unsigned char)rand();
+    memcpy(simd, reference, pixels * 4);
+
+    const double freq = (double)SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    imagePremultiplyScalar(reference, pixels);
+    const double scalarSec = (double)(SDL_GetPerformanceCounter() - start) / freq;
+
+    start = SDL_GetPerformanceCounter();
+    imagePremultiply(simd, pixels);
+    const double simdSec = (double)(SDL_GetPerformanceCounter() - start) / freq;
+
+    const double gb = pixels * 4 / 1e9;
+    printf("Premultiply benchmark: %.0f MB, scalar %.2f GB/s, %s %.2f GB/s (%.1fx), results %s\n",
+           gb * 1000.0, gb / scalarSec, imagePremultiplyPath(), gb / simdSec, scalarSec / simdSec,
+           memcmp(reference, simd, pixels * 4) == 0 ? "match" : "DIFFER");
+    free(reference);
+    free(simd);
+}
+
+static int compareDrawItems(const void* a, const void* b) {
+    const uint64_t x = ((const drawItem*)a)->key, y = ((const drawItem*)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+// radix sort of 1M draw keys against qsort, for keys shaped like a frame's (a few layers, programs
+// and textures) and for fully random ones
+static void benchmarkDrawSort(void) {
+    enum { KEYS = 1024 * 1024, RUNS = 10 };
+    drawItem* keys = malloc(sizeof(drawItem) * KEYS);
+    drawItem* items = malloc(sizeof(drawItem) * KEYS);
+    drawItem* scratch = malloc(sizeof(drawItem) * KEYS);
+    const double freq = (double)SDL_GetPerformanceFrequency();
+
+    printf("Draw key sort benchmark: %d keys, best of %d\n", KEYS, RUNS);
+    for (int random = 0; random < 2; ++random) {
+        for (uint32_t i = 0; i < KEYS; ++i) {
+            const uint64_t r = (uint64_t)rand() << 42 ^ (uint64_t)rand() << 21 ^ (uint64_t)rand();
+            keys[i].key = random ? r : drawKey(rand() % 4, rand() % 3, 1 + rand() % 1000, 0, 0);
+            keys[i].item = i;
+        }
+
+        double radixMs = 0, qsortMs = 0;
+        bool sorted = true;
+        for (int run = 0; run < RUNS; ++run) {
+            memcpy(items, keys, sizeof(drawItem) * KEYS);
+            Uint64 start = SDL_GetPerformanceCounter();
+            drawItemsSort(items, scratch, KEYS);
+            double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / freq;
+            if (run == 0 || ms < radixMs)
+                radixMs = ms;
+            // in key order, and equal keys still in the order they were added
+            for (size_t i = 1; i < KEYS; ++i)
+                sorted &= items[i - 1].key < items[i].key || (items[i - 1].key == items[i].key && items[i - 1].item < items[i].item);
+
+            memcpy(items, keys, sizeof(drawItem) * KEYS);
+            start = SDL_GetPerformanceCounter();
+            qsort(items, KEYS, sizeof(drawItem), compareDrawItems);
+            ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / freq;
+            if (run == 0 || ms < qsortMs)
+                qsortMs = ms;
+        }
+        printf("  %-12s radix %7.2f ms, qsort %7.2f ms (%.1fx), %s\n", random ? "random keys" : "frame keys",
+               radixMs, qsortMs, qsortMs / radixMs, sorted ? "sorted and stable" : "NOT SORTED");
+    }
+    free(keys);
+    free(items);
+    free(scratch);
+}
+
+// glBindTexture calls the sprite loop makes per frame when drawing in array order
+static int countSpriteBinds(const spite* sprites, const size_t spritec) {
+    int binds = 0;
+    GLuint bound = 0;
+    for (size_t i = 0; i < spritec; ++i) {
+        if (sprites[i].texture->textureID != bound) {
+            bound = sprites[i].texture->textureID;
+            binds++;
+        }
+    }
+    return binds;
+}
+
+// texels stored and texels rasterized per frame, full images against trimmed rects
+static void reportTrim(const texture* tex, const size_t texc, const spite* sprites, const size_t spritec) {
+    double fullTexels = 0, trimmedTexels = 0;
+    for (size_t i = 0; i < texc; ++i) {
+        fullTexels += (double)tex[i].width * tex[i].height;
+        trimmedTexels += (double)tex[i].trimWidth * tex[i].trimHeight;
+    }
+
+    double fullArea = 0, trimmedArea = 0;
+    for (size_t i = 0; i < spritec; ++i) {
+        const texture* t = sprites[i].texture;
+        const double s = 2.0 * sprites[i].scale;
+        fullArea += t->width * s * t->height * s;
+        trimmedArea += t->trimWidth * s * t->trimHeight * s;
+    }
+
+    printf("Trimming: %.1f -> %.1f Mtexels stored (-%.1f%%), sprite quads %.2f -> %.2f Mpixels/frame (-%.1f%%)\n",
+           fullTexels / 1e6, trimmedTexels / 1e6, 100.0 * (1.0 - trimmedTexels / fullTexels),
+           fullArea / 1e6, trimmedArea / 1e6, 100.0 * (1.0 - trimmedArea / fullArea));
+}
+
+// levels each image can drop and still have a texel per pixel at the largest size a sprite draws it.
+// images no sprite uses drop MAX_TEXTURE_LOD, the texture cache promotes them if one ever does
+static int* spriteTextureLods(const size_t* spriteTextures, const spite* sprites, const size_t spritec, const size_t texc) {
+    float* largest = calloc(texc, sizeof(float));
+    for (size_t i = 0; i < spritec; ++i) {
+        const float pixels = 2.0f * sprites[i].scale * GlobalScale;
+        if (pixels > largest[spriteTextures[i]])
+            largest[spriteTextures[i]] = pixels;
+    }
+
+    int* lods = malloc(sizeof(int) * texc);
+    for (size_t i = 0; i < texc; ++i)
+        lods[i] = textureLodForScale(largest[i]);
+    free(largest);
+    return lods;
+}
+
+static void reportLod(const texture* tex, const size_t texc) {
+    double trimmedTexels = 0, storedTexels = 0;
+    size_t reduced = 0;
+    for (size_t i = 0; i < texc; ++i) {
+        trimmedTexels += (double)tex[i].trimWidth * tex[i].trimHeight;
+        storedTexels += (double)textureStoredWidth(&tex[i]) * textureStoredHeight(&tex[i]);
+        reduced += tex[i].lod > 0;
+    }
+    printf("Scale-aware loading: %zu/%zu textures reduced, %.1f -> %.1f Mtexels at level 0 (-%.1f%%)\n",
+           reduced, texc, trimmedTexels / 1e6, storedTexels / 1e6, 100.0 * (1.0 - storedTexels / trimmedTexels));
+}
+
+// bytes each image takes in its narrow layout against plain RGBA8, shared textures counted once
+static void reportLayouts(const texture* tex, const size_t texc, const char** paths, const bool perAsset) {
+    size_t count[PIXEL_LAYOUT_COUNT] = { 0 };
+    size_t rgbaBytes = 0, storedBytes = 0;
+    for (size_t i = 0; i < texc; ++i) {
+        bool seen = !tex[i].ready;
+        for (size_t j = 0; j < i && !seen; ++j)
+            seen = tex[j].textureID == tex[i].textureID;
+        if (seen)
+            continue;
+
+        texture rgba = tex[i];
+        rgba.layout = PIXEL_RGBA8;
+        const size_t full = textureBytes(&rgba), stored = textureBytes(&tex[i]);
+        count[tex[i].layout]++;
+        rgbaBytes += full;
+        storedBytes += stored;
+        if (perAsset && tex[i].layout != PIXEL_RGBA8)
+            printf("  %-60s %-32s %8zu -> %8zu bytes\n", paths[i], pixelLayoutName(tex[i].layout), full, stored);
+    }
+
+    printf("Texture formats:");
+    for (int l = 0; l < PIXEL_LAYOUT_COUNT; ++l) {
+        if (count[l])
+            printf(" %zu %s,", count[l], pixelLayoutName(l));
+    }
+    printf(" %.1f -> %.1f MiB (-%.1f%%)\n", rgbaBytes / (1024.0 * 1024.0), storedBytes / (1024.0 * 1024.0),
+           100.0 * (1.0 - (double)storedBytes / (double)(rgbaBytes ? rgbaBytes : 1)));
+}
+
+typedef struct {
+    const char* path; // points into one of the image paths, len bytes long
+    size_t len;
+    size_t images, indexed;
+    size_t rgbaBytes, storedBytes; // indexed images only, storedBytes includes their palettes
+    size_t paletteBytes;
+} folderPalettes;
+
+// what indexing saved per asset folder. memory counts the palettes, texel bytes are what
+// sampling reads per texel (the palettes are small enough to stay in cache)
+static void reportPalettes(const texture* tex, const size_t texc, const char** paths) {
+    folderPalettes* folders = calloc(texc ? texc : 1, sizeof(folderPalettes));
+    size_t folderc = 0;
+    for (size_t i = 0; i < texc; ++i) {
+        bool seen = !tex[i].ready;
+        for (size_t j = 0; j < i && !seen; ++j)
+            seen = tex[j].textureID == tex[i].textureID;
+        if (seen)
+            continue;
+
+        const char* slash = strrchr(paths[i], '/');
+        const size_t len = slash ? (size_t)(slash - paths[i]) : 0;
+        size_t f = 0;
+        while (f < folderc && (folders[f].len != len || strncmp(folders[f].path, paths[i], len) != 0))
+            f++;
+        if (f == folderc)
+            folders[folderc++] = (folderPalettes){ .path = paths[i], .len = len };
+
+        folders[f].images++;
+        if (tex[i].layout != PIXEL_INDEXED8)
+            continue;
+        texture rgba = tex[i];
+        rgba.layout = PIXEL_RGBA8;
+        folders[f].indexed++;
+        folders[f].rgbaBytes += textureBytes(&rgba);
+        folders[f].storedBytes += textureBytes(&tex[i]);
+        folders[f].paletteBytes += PALETTE_BYTES;
+    }
+
+    folderPalettes total = { 0 };
+    printf("Indexed textures by folder:\n");
+    for (size_t f = 0; f < folderc; ++f) {
+        const folderPalettes* d = &folders[f];
+        total.images += d->images;
+        total.indexed += d->indexed;
+        total.rgbaBytes += d->rgbaBytes;
+        total.storedBytes += d->storedBytes;
+        total.paletteBytes += d->paletteBytes;
+        if (d->indexed)
+            printf("  %-48.*s %4zu/%-4zu indexed, %8.1f -> %7.1f KiB memory, %8.1f -> %7.1f KiB of texels\n",
+                   (int)d->len, d->path, d->indexed, d->images, d->rgbaBytes / 1024.0, d->storedBytes / 1024.0,
+                   d->rgbaBytes / 1024.0, (d->storedBytes - d->paletteBytes) / 1024.0);
+    }
+    printf("  %zu/%zu textures indexed, %.1f -> %.1f MiB (-%.1f%%)\n", total.indexed, total.images,
+           total.rgbaBytes / (1024.0 * 1024.0), total.storedBytes / (1024.0 * 1024.0),
+           100.0 * (1.0 - (double)total.storedBytes / (double)(total.rgbaBytes ? total.rgbaBytes : 1)));
+    free(folders);
+}
+
+// texture memory the load is going to need, known from the manifest before anything is decoded
+static void reportManifest(const imageManifest* manifest, const size_t count, const int* lods) {
+    size_t bytes = 0, rgbaBytes = 0, indexed = 0, opaque = 0, stale = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const manifestEntry* e = imageManifestEntry(manifest, i);
+        if (!e) {
+            stale++;
+            continue;
+        }
+        int w, h;
+        pixelLayout layout;
+        decodePredict(e, DecodeFlags, lods ? lods[i] : 0, &w, &h, &layout);
+        bytes += pixelLayoutLevelSize(layout, w, h) + (layout == PIXEL_INDEXED8 ? PALETTE_BYTES : 0);
+        rgbaBytes += (size_t)e->width * e->height * 4;
+        indexed += layout == PIXEL_INDEXED8;
+        opaque += e->opaqueWidth == e->width && e->opaqueHeight == e->height;
+    }
+    printf("Manifest: %zu images, %.1f MiB of texture storage ahead (%.1f MiB as full RGBA8), %zu indexed, %zu fully opaque, %zu stale\n",
+           count - stale, bytes / (1024.0 * 1024.0), rgbaBytes / (1024.0 * 1024.0), indexed, opaque, stale);
+}
+
+// how much of the load came out of the decoded-image cache instead of PNG decoding
+static void reportImageCache(void) {
+    imageCacheStats stats;
+    imageCacheGetStats(&stats);
+    printf("Image cache: %zu hits, %zu misses, %zu stale", stats.hits, stats.misses, stats.stale);
+    if (stats.hits)
+        printf(", %.1f MiB read for %.1f MiB of pixels", stats.cachedBytes / (1024.0 * 1024.0),
+               stats.decodedBytes / (1024.0 * 1024.0));
+    printf("\n");
+}
+
+typedef enum {
+    STORAGE_TEXTURES, // one GL texture per image
+    STORAGE_ATLAS,
+    STORAGE_ARRAYS,
+} spriteStorage;
+
+// moves the loaded textures into atlas pages or texture arrays, returns true if sprites now need the array shader
+static bool buildSpriteStorage(const spriteStorage storage, texture* tex, const size_t texc, const int param, const spite* sprites, const size_t spritec) {
+    if (storage == STORAGE_TEXTURES)
+        return false;
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const int bindsBefore = countSpriteBinds(sprites, spritec);
+    bool ok;
+
+    if (storage == STORAGE_ATLAS) {
+        atlasStats stats;
+        ok = atlasBuild(tex, texc, param, &stats);
+        printf("Atlas: %zu textures on %d pages of %dx%d, %.1f%% used, %zu too large or not RGBA8\n",
+               stats.packed, stats.pages, stats.pageSize, stats.pageSize, stats.efficiency * 100.0, stats.skipped);
+    } else {
+        textureArrayStats stats;
+        ok = textureArrayBuild(tex, texc, param, &stats);
+        printf("Texture arrays: %zu layers in %d arrays over %d size buckets, %.1f%% padding, %zu not RGBA8\n",
+               stats.layers, stats.arrays, stats.buckets,
+               100.0 * (double)stats.paddingTexels / (double)(stats.imageTexels + stats.paddingTexels + 1), stats.skipped);
+    }
+    if (!ok)
+        fprintf(stderr, "Building sprite storage reported a GL error\n");
+
+    const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    printf("Sprite texture binds per frame %d -> %d, rebuilt in %.2f ms\n", bindsBefore, countSpriteBinds(sprites, spritec), ms);
+    return storage == STORAGE_ARRAYS;
+}
+
+// VRAM taken by the resolve target and its 4x MSAA counterpart
+static size_t renderTargetBytes(const framebuffer* fb) {
+    return (size_t)fb->renderWidth * fb->renderHeight * 4 * (1 + 4);
+}
+
+// residency only works per texture, atlas pages and arrays stay resident as a whole
+static textureCache* startTextureCache(texture* tex, const size_t texc, const spriteStorage storage, const size_t budgetBytes,
+                                       const bool scaleAware, const size_t uploadBudget, const texturePack* pack, const int decodeThreads) {
+    if (!budgetBytes && !scaleAware)
+        return nullptr;
+    if (storage != STORAGE_TEXTURES) {
+        if (budgetBytes)
+            fprintf(stderr, "VRAM budget ignored, atlas and array storage cannot evict single textures\n");
+        return nullptr;
+    }
+
+    textureCache* cache = textureCacheCreate(tex, texc, budgetBytes, uploadBudget, pack, images, decodeThreads, DecodeFlags);
+    if (!cache)
+        return nullptr;
+    textureCacheSetReserved(cache, renderTargetBytes(&drawBuffer));
+
+    textureCacheStats stats;
+    textureCacheGetStats(cache, &stats);
+    printf("Texture cache: %zu textures, %.1f MiB resident, %.1f MiB budget, reloading from %s\n",
+           stats.managed, stats.residentBytes / (1024.0 * 1024.0), budgetBytes / (1024.0 * 1024.0), pack ? "the pack" : "png");
+    if (!budgetBytes)
+        printf("Texture cache: no VRAM budget, only promoting textures sprites outgrow\n");
+    return cache;
+}
+
+// times a full load + upload of the asset set at 1, 2, 4, ... threads up to threadCount
+static void benchmarkDecodeThreads(const char** paths, const size_t pathsc, const int threadCount) {
+    printf("Decode benchmark: %zu images, 1..%d threads\n", pathsc, threadCount);
+    for (int threads = 1;; threads *= 2) {
+        if (threads > threadCount)
+            threads = threadCount;
+
+        texture* tex = loadTextures(paths, pathsc, threads, nullptr);
+        if (!tex)
+            return;
+        unloadTextures(tex, pathsc);
+
+        if (threads == threadCount)
+            break;
+    }
+}
+
+// decode time for the whole asset set per way of reading files, straight after evicting the
+// files from the page cache (a cold start without needing root for drop_caches) and then again warm
+static void benchmarkFileReading(const char** paths, const size_t pathsc, const int threadCount) {
+    static const unsigned modes[] = { 0, DECODE_BATCHED_IO | DECODE_IO_THREADS, DECODE_BATCHED_IO };
+    const unsigned flags = DecodeFlags & ~(DECODE_BATCHED_IO | DECODE_IO_THREADS);
+
+    printf("File reading benchmark: %zu images, %d decode threads\n", pathsc, threadCount);
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        double ms[2];
+        const char* backend = nullptr;
+        for (int warm = 0; warm < 2; ++warm) {
+            size_t evicted = 0;
+            for (size_t i = 0; i < pathsc && !warm; ++i)
+                evicted += fileEvictFromPageCache(paths[i]);
+            if (!warm && evicted < pathsc)
+                printf("  only %zu/%zu files could be evicted, the cold run is partly warm\n", evicted, pathsc);
+
+            const Uint64 start = SDL_GetPerformanceCounter();
+            decodePool* pool = decodePoolCreate(threadCount, flags | modes[m]);
+            if (!pool)
+                return;
+            for (size_t i = 0; i < pathsc; ++i)
+                decodePoolSubmit(pool, i, paths[i], 0);
+            decodeResult res;
+            while (decodePoolPop(pool, &res, true)) {
+                stbi_image_free(res.pixels);
+                free(res.palette);
+            }
+            backend = decodePoolIoBackend(pool);
+            decodePoolDestroy(pool);
+            ms[warm] = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+        }
+        // asking for io_uring where it isn't available just repeats the thread fallback
+        if (m > 0 && strcmp(backend, "threads") == 0 && modes[m] == DECODE_BATCHED_IO)
+            backend = "threads (io_uring unavailable)";
+        printf("  %-32s cold %8.2f ms, warm %8.2f ms\n", backend, ms[0], ms[1]);
+    }
+}
+
 GLuint loadShaderDir(const char* source, GLenum type) {
     GLuint shader = glCreateShader(type);
     if (!shader) {
@@ -206,6 +852,83 @@ void createTransformationMatrix(float* matrix, const float translateX, const flo
     matrix[13] = translateY;
 }
 
+// only the trimmed rect of the texture is drawn, shifted so it lands where it sat in the full image
+static void spriteModelMatrix(float* matrix, const spite* sprite, const float globalScale) {
+    const texture* tex = sprite->texture;
+    const float s = sprite->scale * globalScale;
+    const float offsetX = (2.0f * tex->trimX + tex->trimWidth - tex->width) * s;
+    const float offsetY = -(2.0f * tex->trimY + tex->trimHeight - tex->height) * s;
+    const float c = cosf(sprite->rot), sn = sinf(sprite->rot);
+
+    createTransformationMatrix(matrix,
+        sprite->x * globalScale + c * offsetX - sn * offsetY,
+        sprite->y * globalScale + sn * offsetX + c * offsetY,
+        tex->trimWidth * s, -tex->trimHeight * s, sprite->rot);
+}
+
+// sprites are all on one layer and flat, so layer and depth stay 0 and equal keys keep submission order
+static uint64_t spriteDrawKey(const spite* sprite, const bool arrays) {
+    const texture* tex = sprite->texture;
+    const int program = spriteProgramFor(tex, arrays);
+    return drawKey(0, (unsigned)program, tex->textureID, program == SPRITE_PROGRAM_INDEXED ? tex->paletteID : 0, 0);
+}
+
+typedef enum {
+    ORDER_SUBMITTED,
+    ORDER_SORTED, // by draw key, ignores overlap so it can change what's on screen
+    ORDER_MERGED, // submission order with draws of equal state pulled together where nothing overlaps them
+    ORDER_COUNT
+} spriteOrder;
+
+static const char* spriteOrderName(const spriteOrder order) {
+    switch (order) {
+        case ORDER_SUBMITTED: return "submitted";
+        case ORDER_SORTED: return "sorted";
+        case ORDER_MERGED: return "merged";
+        default: return "unknown";
+    }
+}
+
+// draws sprites whose model matrices are already in models, in the given order.
+// time spent building the order, not drawing, is added to orderTime
+static void drawSprites(spriteRenderer* renderer, const spite* sprites, float (*models)[16], const int count, const spriteOrder order,
+                        const bool arrays, drawList* list, batchBuilder* builder, Uint64* orderTime) {
+    if (order == ORDER_SUBMITTED) {
+        for (int i = 0; i < count; ++i)
+            spriteRendererDraw(renderer, sprites[i].texture, models[i]);
+        return;
+    }
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    size_t drawc;
+    if (order == ORDER_SORTED) {
+        drawListClear(list);
+        for (int i = 0; i < count; ++i)
+            drawListAdd(list, spriteDrawKey(&sprites[i], arrays), (uint32_t)i);
+        drawListSort(list);
+        const drawItem* sorted = drawListItems(list, &drawc);
+        *orderTime += SDL_GetPerformanceCounter() - start;
+        for (size_t d = 0; d < drawc; ++d)
+            spriteRendererDraw(renderer, sprites[sorted[d].item].texture, models[sorted[d].item]);
+        return;
+    }
+
+    batchBuilderBegin(builder, drawBuffer.renderWidth, drawBuffer.renderHeight);
+    for (int i = 0; i < count; ++i) {
+        const float* m = models[i];
+        // the quad spans -1 to 1. padded a pixel, sprites that only come close can still blend into the same one
+        const float extentX = fabsf(m[0]) + fabsf(m[4]) + 1.0f;
+        const float extentY = fabsf(m[1]) + fabsf(m[5]) + 1.0f;
+        batchBuilderAdd(builder, spriteDrawKey(&sprites[i], arrays), m[12] - extentX, m[13] - extentY, m[12] + extentX, m[13] + extentY,
+                        (uint32_t)i);
+    }
+    size_t batchc;
+    const uint32_t* items = batchBuilderOrder(builder, &drawc, &batchc);
+    *orderTime += SDL_GetPerformanceCounter() - start;
+    for (size_t d = 0; d < drawc; ++d)
+        spriteRendererDraw(renderer, sprites[items[d]].texture, models[items[d]]);
+}
+
 void createOrthographicMatrix(float* matrix, const float left, const float right,const float bottom, const float top, const float near, const float far) {
     memset(matrix, 0, sizeof(float) * 16);
     matrix[0] = 2.0f / (right - left);
@@ -255,6 +978,162 @@ void shuffle_sprites(spite* sprites, const size_t spritec) {
     }
 }
 
+// a uniform block's data for this frame, out of the ring when there is one and it has room
+static void bindFrameUniforms(ringBuffer* ring, const GLuint fallback, const GLuint binding, const void* data, const size_t size) {
+    static GLint alignment;
+    if (!alignment)
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    size_t offset;
+    void* memory = ring ? ringBufferAlloc(ring, size, (size_t)alignment, &offset) : nullptr;
+    if (memory) {
+        memcpy(memory, data, size);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, ringBufferName(ring), (GLintptr)offset, (GLsizeiptr)size);
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, fallback);
+    glBufferData(GL_UNIFORM_BUFFER, size, data, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, fallback);
+}
+
+// frame time against sprite count for every sprite path, drawn into drawBuffer with the textures
+// as they are stored (plain, atlas pages or arrays). each frame waits on glFinish so GPU time counts too
+static void benchmarkSprites(spriteRenderer* renderer, ringBuffer* ring, const texture* tex, const size_t texc, const bool arrays,
+                             const bool premultiplied) {
+    enum { MAX_SPRITES = 65536, FRAMES = 20 };
+    spite* sprites = malloc(sizeof(spite) * MAX_SPRITES);
+    for (int i = 0; i < MAX_SPRITES; ++i) {
+        sprites[i] = (spite){
+            .x = rand() % drawBuffer.renderWidth,
+            .y = rand() % drawBuffer.renderHeight,
+            .rot = (rand() % 628) / 100.0f,
+            .scale = 0.25f,
+            .texture = &tex[(159 + i) % texc],
+        };
+    }
+
+    float projection[16];
+    createOrthographicMatrix(projection, 0, drawBuffer.renderWidth, 0, drawBuffer.renderHeight, -1.0f, 1.0f);
+    glBindFramebuffer(GL_FRAMEBUFFER, drawBuffer.bufferId);
+    glViewport(0, 0, drawBuffer.renderWidth, drawBuffer.renderHeight);
+    glBlendFunc(premultiplied ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    printf("Sprite benchmark: ms per frame and draw calls, %s\n",
+           arrays ? "texture arrays" : tex[0].atlasPage >= 0 ? "atlas pages" : "one texture per image");
+    printf("  %7s", "sprites");
+    for (int path = 0; path < SPRITE_PATH_COUNT; ++path)
+        printf("  %22s", spritePathName((spritePath)path));
+    printf("\n");
+    for (int count = 256; count <= MAX_SPRITES; count *= 2) {
+        printf("  %7d", count);
+        for (int path = 0; path < SPRITE_PATH_COUNT; ++path) {
+            Uint64 start = 0;
+            // the first frame warms up, buffers grow to size there
+            for (int frame = 0; frame <= FRAMES; ++frame) {
+                if (frame == 1) {
+                    start = SDL_GetPerformanceCounter();
+                    spriteRendererResetStats(renderer);
+                }
+                glClear(GL_COLOR_BUFFER_BIT);
+                if (ring)
+                    ringBufferBeginFrame(ring);
+                spriteRendererBegin(renderer, (spritePath)path, projection, arrays);
+                for (int i = 0; i < count; ++i) {
+                    float model[16];
+                    spriteModelMatrix(model, &sprites[i], GlobalScale);
+                    spriteRendererDraw(renderer, sprites[i].texture, model);
+                }
+                spriteRendererEnd(renderer);
+                if (ring)
+                    ringBufferEndFrame(ring);
+                glFinish();
+            }
+            const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+            spriteRendererStats stats;
+            spriteRendererGetStats(renderer, &stats);
+            printf("  %9.3f ms %6zu draws", ms / FRAMES, stats.drawCalls / FRAMES);
+        }
+        printf("\n");
+    }
+    CHECK_GL_ERRORS();
+
+    spriteRendererResetStats(renderer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    free(sprites);
+}
+
+// draws the same overlapping sprites in every order and path into drawBuffer and compares the pixels with
+// submission order on that path. merged has to match exactly, sorted shows the comparison catches reordering
+static bool verifySpriteMerge(spriteRenderer* renderer, ringBuffer* ring, const texture* tex, const size_t texc, const bool arrays,
+                              const bool premultiplied, drawList* list, batchBuilder* builder) {
+    enum { SPRITES = 4096 };
+    spite* sprites = malloc(sizeof(spite) * SPRITES);
+    float (*models)[16] = malloc(sizeof(float[16]) * SPRITES);
+    for (int i = 0; i < SPRITES; ++i) {
+        sprites[i] = (spite){
+            .x = rand() % drawBuffer.renderWidth,
+            .y = rand() % drawBuffer.renderHeight,
+            .rot = (rand() % 628) / 100.0f,
+            .scale = 0.25f,
+            .texture = &tex[rand() % texc],
+        };
+        spriteModelMatrix(models[i], &sprites[i], GlobalScale);
+    }
+
+    const size_t pixelBytes = (size_t)drawBuffer.renderWidth * drawBuffer.renderHeight * 4;
+    unsigned char* pixels[ORDER_COUNT];
+    for (int order = 0; order < ORDER_COUNT; ++order)
+        pixels[order] = malloc(pixelBytes);
+
+    float projection[16];
+    createOrthographicMatrix(projection, 0, drawBuffer.renderWidth, 0, drawBuffer.renderHeight, -1.0f, 1.0f);
+    glBindFramebuffer(GL_FRAMEBUFFER, drawBuffer.bufferId);
+    glViewport(0, 0, drawBuffer.renderWidth, drawBuffer.renderHeight);
+    glBlendFunc(premultiplied ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(100/255.0f, 149/255.0f, 237/255.0f, 1.0f);
+
+    bool identical = true;
+    Uint64 orderTime = 0;
+    printf("Draw order check: %d sprites, pixels differing from submission order\n", SPRITES);
+    for (int path = 0; path < SPRITE_PATH_COUNT; ++path) {
+        printf("  %-10s", spritePathName((spritePath)path));
+        for (int order = 0; order < ORDER_COUNT; ++order) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (ring)
+                ringBufferBeginFrame(ring);
+            spriteRendererResetStats(renderer);
+            spriteRendererBegin(renderer, (spritePath)path, projection, arrays);
+            drawSprites(renderer, sprites, models, SPRITES, (spriteOrder)order, arrays, list, builder, &orderTime);
+            spriteRendererEnd(renderer);
+            if (ring)
+                ringBufferEndFrame(ring);
+            glReadPixels(0, 0, drawBuffer.renderWidth, drawBuffer.renderHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels[order]);
+
+            size_t differing = 0;
+            for (size_t p = 0; p < pixelBytes; p += 4)
+                differing += memcmp(pixels[order] + p, pixels[ORDER_SUBMITTED] + p, 4) != 0;
+            if (order == ORDER_MERGED && differing)
+                identical = false;
+
+            spriteRendererStats stats;
+            spriteRendererGetStats(renderer, &stats);
+            printf("  %s: %6zu draws %8zu px", spriteOrderName((spriteOrder)order), stats.drawCalls, differing);
+        }
+        printf("\n");
+    }
+    CHECK_GL_ERRORS();
+    if (!identical)
+        fprintf(stderr, "Merged draw order changed the image\n");
+
+    spriteRendererResetStats(renderer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    for (int order = 0; order < ORDER_COUNT; ++order)
+        free(pixels[order]);
+    free(models);
+    free(sprites);
+    return identical;
+}
+
 void calculateViewportWithAspectRatio(const int windowWidth, const int windowHeight, const int targetWidth, const  int targetHeight,  int* viewportX, int* viewportY, int* viewportWidth, int* viewportHeight) {
     //const float targetAspect = (float)targetWidth / (float)targetHeight;
     //const float windowAspect = (float)windowWidth / (float)windowHeight;
@@ -289,14 +1168,14 @@ void calculateViewportWithAspectRatio(const int windowWidth, const int windowHei
 }
 
 void createFBOs(framebuffer* normalFBO, framebuffer* msaaFBO, const int width, const int height) {
-    if (normalFBO->bufferId < 0)
+    if (normalFBO->bufferId != 0)
         glDeleteFramebuffers(1, &normalFBO->bufferId);
-    if (normalFBO->colorTexture < 0)
+    if (normalFBO->colorTexture != 0)
         glDeleteTextures(1, &normalFBO->colorTexture);
 
-    if (msaaFBO->bufferId < 0)
+    if (msaaFBO->bufferId != 0)
         glDeleteFramebuffers(1, &msaaFBO->bufferId);
-    if (msaaFBO->colorTexture < 0)
+    if (msaaFBO->colorTexture != 0)
         glDeleteTextures(1, &msaaFBO->colorTexture);
 
 
@@ -352,6 +1231,173 @@ int main(const int argc, char **argv)
 #endif
     srand((unsigned)time(NULL));
 
+    int decodeThreads = decodePoolDefaultThreads();
+    bool benchDecode = false;
+    bool benchPremultiply = false;
+    bool benchSort = false;
+    spriteOrder drawOrder = ORDER_SUBMITTED;
+    bool verifyMerge = false;
+    bool benchIO = false;
+    bool benchUpload = false;
+    bool benchSprites = false;
+    bool useRingBuffer = true;
+    spritePath renderPath = SPRITES_INSTANCED;
+    bool immutableTextures = true;
+    bool reportFormats = false;
+    bool streamTextures = true;
+#ifdef DEFAULT_TEXTURE_PACK
+    const char* packPath = DEFAULT_TEXTURE_PACK;
+#else
+    const char* packPath = nullptr;
+#endif
+#ifdef EMBEDDED_TEXTURE_PACK
+    bool useEmbeddedPack = true; // --pack and --no-pack turn it off
+#else
+    const bool useEmbeddedPack = false;
+#endif
+    const char* benchPackPath = nullptr;
+    const char* imageCacheDir = "image_cache";
+#ifdef DEFAULT_MANIFEST
+    const char* manifestPath = DEFAULT_MANIFEST;
+#else
+    const char* manifestPath = nullptr;
+#endif
+    spriteStorage storage = STORAGE_TEXTURES;
+    int atlasPageSize = 4096;
+    int arrayGranularity = 1;
+    size_t uploadBudget = DEFAULT_UPLOAD_BUDGET;
+    size_t vramBudget = 0;
+    bool scaleAware = true;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--decode-threads") == 0 && i + 1 < argc) {
+            decodeThreads = atoi(argv[++i]);
+            if (decodeThreads < 1)
+                decodeThreads = 1;
+        } else if (strcmp(argv[i], "--bench-decode") == 0) {
+            benchDecode = true;
+        } else if (strcmp(argv[i], "--no-trim") == 0) {
+            DecodeFlags &= ~DECODE_TRIM;
+        } else if (strcmp(argv[i], "--no-dedup") == 0) {
+            DecodeFlags &= ~DECODE_HASH;
+        } else if (strcmp(argv[i], "--rgba-only") == 0) {
+            DecodeFlags &= ~(DECODE_NARROW | DECODE_PALETTE);
+        } else if (strcmp(argv[i], "--no-palette") == 0) {
+            DecodeFlags &= ~DECODE_PALETTE;
+        } else if (strcmp(argv[i], "--allow-565") == 0) {
+            DecodeFlags |= DECODE_LOSSY;
+        } else if (strcmp(argv[i], "--report-formats") == 0) {
+            reportFormats = true;
+        } else if (strcmp(argv[i], "--straight-alpha") == 0) {
+            DecodeFlags &= ~DECODE_PREMULTIPLY;
+        } else if (strcmp(argv[i], "--bench-premultiply") == 0) {
+            benchPremultiply = true;
+        } else if (strcmp(argv[i], "--bench-sort") == 0) {
+            benchSort = true;
+        } else if (strcmp(argv[i], "--sort-sprites") == 0) {
+            drawOrder = ORDER_SORTED;
+        } else if (strcmp(argv[i], "--merge-sprites") == 0) {
+            drawOrder = ORDER_MERGED;
+        } else if (strcmp(argv[i], "--verify-merge") == 0) {
+            verifyMerge = true;
+            streamTextures = false;
+        } else if (strcmp(argv[i], "--blocking-io") == 0) {
+            DecodeFlags &= ~DECODE_BATCHED_IO;
+        } else if (strcmp(argv[i], "--io-threads") == 0) {
+            DecodeFlags |= DECODE_BATCHED_IO | DECODE_IO_THREADS;
+        } else if (strcmp(argv[i], "--bench-io") == 0) {
+            benchIO = true;
+        } else if (strcmp(argv[i], "--mutable-textures") == 0) {
+            immutableTextures = false;
+        } else if (strcmp(argv[i], "--persistent-staging") == 0) {
+            StagingBytes = DEFAULT_STAGING_BYTES;
+        } else if (strcmp(argv[i], "--bench-upload") == 0) {
+            benchUpload = true;
+        } else if (strcmp(argv[i], "--sprite-path") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            int path = 0;
+            while (path < SPRITE_PATH_COUNT && strcmp(name, spritePathName((spritePath)path)) != 0)
+                path++;
+            if (path < SPRITE_PATH_COUNT)
+                renderPath = (spritePath)path;
+            else
+                fprintf(stderr, "Unknown sprite path '%s'\n", name);
+        } else if (strcmp(argv[i], "--no-ring-buffer") == 0) {
+            useRingBuffer = false;
+        } else if (strcmp(argv[i], "--bench-sprites") == 0) {
+            benchSprites = true;
+            streamTextures = false;
+        } else if (strcmp(argv[i], "--sync-load") == 0) {
+            streamTextures = false;
+        } else if (strcmp(argv[i], "--upload-budget-kb") == 0 && i + 1 < argc) {
+            uploadBudget = (size_t)atol(argv[++i]) * 1024;
+        } else if (strcmp(argv[i], "--vram-budget-mb") == 0 && i + 1 < argc) {
+            vramBudget = (size_t)atol(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--no-lod") == 0) {
+            scaleAware = false;
+        } else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+            packPath = argv[++i];
+#ifdef EMBEDDED_TEXTURE_PACK
+            useEmbeddedPack = false;
+#endif
+        } else if (strcmp(argv[i], "--no-pack") == 0) {
+            packPath = nullptr;
+#ifdef EMBEDDED_TEXTURE_PACK
+            useEmbeddedPack = false;
+#endif
+        } else if (strcmp(argv[i], "--bench-pack") == 0 && i + 1 < argc) {
+            benchPackPath = argv[++i];
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            manifestPath = argv[++i];
+        } else if (strcmp(argv[i], "--no-manifest") == 0) {
+            manifestPath = nullptr;
+        } else if (strcmp(argv[i], "--image-cache") == 0 && i + 1 < argc) {
+            imageCacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--no-image-cache") == 0) {
+            imageCacheDir = nullptr;
+        } else if (strcmp(argv[i], "--atlas") == 0) {
+            storage = STORAGE_ATLAS;
+        } else if (strcmp(argv[i], "--atlas-size") == 0 && i + 1 < argc) {
+            atlasPageSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--arrays") == 0) {
+            storage = STORAGE_ARRAYS;
+        } else if (strcmp(argv[i], "--array-granularity") == 0 && i + 1 < argc) {
+            arrayGranularity = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
+        }
+    }
+
+    // blits into atlas pages and array layers copy raw channels, they never see a swizzle or palette
+    if (storage != STORAGE_TEXTURES)
+        DecodeFlags &= ~(DECODE_NARROW | DECODE_PALETTE);
+
+    // before the image cache is on, so every run really reads and decodes the PNGs
+    if (benchIO) {
+        benchmarkFileReading(images, suki_sprites, decodeThreads);
+        return 0;
+    }
+    // the other decode benchmarks need GL first, so they just run without the cache
+    if (benchDecode || benchUpload || benchPackPath) {
+        if (imageCacheDir)
+            printf("Image cache off for the benchmarks\n");
+        imageCacheDir = nullptr;
+    }
+    if (imageCacheDir)
+        imageCacheEnable(imageCacheDir);
+    // only the PNG loads use it. opening it stats every source, which a pack-only startup must not do
+    const bool loadsPngs = (!packPath && !useEmbeddedPack) || benchDecode || benchUpload || benchPackPath;
+    if (manifestPath && loadsPngs)
+        AssetManifest = imageManifestOpen(manifestPath, images, suki_sprites);
+
+    if (benchPremultiply) {
+        benchmarkPremultiply();
+        return 0;
+    }
+    if (benchSort) {
+        benchmarkDrawSort();
+        return 0;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "SDL_Init error: %s\n", SDL_GetError());
         return 1;
@@ -394,6 +1440,8 @@ int main(const int argc, char **argv)
         fprintf(stderr, "Failed to initialize GLAD\n");
         return -1;
     }
+    if (immutableTextures && !textureUploadSetImmutable(true))
+        printf("No ARB_texture_storage, textures get mutable storage\n");
 
     glEnable(GL_BLEND);
     glEnable(GL_MULTISAMPLE);
@@ -404,19 +1452,87 @@ int main(const int argc, char **argv)
     }
     CHECK_GL_ERRORS();
 
-    texture* allSprites = loadTextures(images, suki_sprites);
+    if (benchDecode)
+        benchmarkDecodeThreads(images, suki_sprites, decodeThreads);
+    if (benchUpload)
+        benchmarkUploads(images, suki_sprites, decodeThreads);
+    if (benchPackPath)
+        benchmarkPack(images, suki_sprites, decodeThreads, benchPackPath);
 
     spite* sprites = (spite*)malloc(sizeof(spite) * SPRITE_COUNT);
-    size_t texture = 159;
+    size_t* spriteTextures = malloc(sizeof(size_t) * SPRITE_COUNT);
+    size_t nextTexture = 159;
 
     for (int i = 0; i < SPRITE_COUNT; i++) {
         sprites[i] = (spite){ 0 };
-        sprites[i].texture = allSprites[texture];
+        spriteTextures[i] = nextTexture;
         sprites[i].scale = 0.25f ;
         sprites[i].x = rand() % drawBuffer.renderWidth;
         sprites[i].y = rand() % drawBuffer.renderHeight;
 
-        texture = ++texture % suki_sprites;
+        nextTexture = (nextTexture + 1) % suki_sprites;
+    }
+    int* lods = scaleAware ? spriteTextureLods(spriteTextures, sprites, SPRITE_COUNT, suki_sprites) : nullptr;
+    if (AssetManifest && !packPath && !useEmbeddedPack)
+        reportManifest(AssetManifest, suki_sprites, lods);
+
+    const Uint64 loadStart = SDL_GetPerformanceCounter();
+    textureStream* stream = nullptr;
+    texture* allSprites;
+    texturePack* pack = nullptr; // kept open for the texture cache to reload from
+    bool premultipliedSprites = DecodeFlags & DECODE_PREMULTIPLY;
+    if (packPath || useEmbeddedPack) {
+#ifdef EMBEDDED_TEXTURE_PACK
+        pack = useEmbeddedPack ? embeddedPackOpen() : texturePackOpen(packPath);
+#else
+        pack = texturePackOpen(packPath);
+#endif
+        allSprites = pack ? loadTexturesFromPack(pack, images, suki_sprites, lods) : nullptr;
+        premultipliedSprites = pack && texturePackFlags(pack) & PACK_FLAG_PREMULTIPLIED;
+        // the array shader samples every sprite from a layer, a compressed pack has none to give it
+        for (size_t i = 0; allSprites && storage == STORAGE_ARRAYS && i < suki_sprites; ++i) {
+            if (allSprites[i].layout != PIXEL_RGBA8) {
+                fprintf(stderr, "Texture pack is %s compressed, drawing from plain textures instead of arrays\n",
+                        pixelLayoutName(allSprites[i].layout));
+                storage = STORAGE_TEXTURES;
+            }
+        }
+    } else if (streamTextures) {
+        stream = textureStreamCreate(images, suki_sprites, decodeThreads, DecodeFlags, uploadBudget, lods, AssetManifest,
+                                     StagingBytes);
+        allSprites = stream ? textureStreamTextures(stream) : nullptr;
+    } else {
+        allSprites = loadTextures(images, suki_sprites, decodeThreads, lods);
+    }
+    free(lods);
+    if (!allSprites) {
+        free(spriteTextures);
+        free(sprites);
+        texturePackClose(pack);
+        SDL_GL_DestroyContext(gl_ctx);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        return 1;
+    }
+
+    for (int i = 0; i < SPRITE_COUNT; i++)
+        sprites[i].texture = &allSprites[spriteTextures[i]];
+    free(spriteTextures);
+    const int storageParam = storage == STORAGE_ATLAS ? atlasPageSize : arrayGranularity;
+    bool spritesInArrays = false;
+    textureCache* residency = nullptr;
+    if (!stream) {
+        if (imageCacheEnabled() && !pack)
+            reportImageCache();
+        reportTrim(allSprites, suki_sprites, sprites, SPRITE_COUNT);
+        if (scaleAware)
+            reportLod(allSprites, suki_sprites);
+        if (DecodeFlags & (DECODE_NARROW | DECODE_PALETTE) && !pack)
+            reportLayouts(allSprites, suki_sprites, images, reportFormats);
+        if (DecodeFlags & DECODE_PALETTE && !pack)
+            reportPalettes(allSprites, suki_sprites, images);
+        spritesInArrays = buildSpriteStorage(storage, allSprites, suki_sprites, storageParam, sprites, SPRITE_COUNT);
+        residency = startTextureCache(allSprites, suki_sprites, storage, vramBudget, scaleAware, uploadBudget, pack, decodeThreads);
     }
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -470,9 +1586,47 @@ int main(const int argc, char **argv)
         makeShaderProgram(loadShaderDir(fsr_like_frag_shader,GL_FRAGMENT_SHADER) , vertexShader),
         makeShaderProgram(loadShaderDir(sharp_lanczos_frag_shader,GL_FRAGMENT_SHADER) , vertexShader),
     };
+
+    const GLuint spriteVertexShader = loadShaderDir(sprite_vert_shader, GL_VERTEX_SHADER);
+    const GLuint instancedVertexShader = loadShaderDir(sprite_instanced_vert_shader, GL_VERTEX_SHADER);
+    const GLuint batchedVertexShader = loadShaderDir(sprite_batched_vert_shader, GL_VERTEX_SHADER);
+    const GLuint spriteShaders[SPRITE_PATH_COUNT][SPRITE_PROGRAM_COUNT] = {
+        [SPRITES_PER_DRAW] = {
+            makeShaderProgram(loadShaderDir(simple_frag_shader, GL_FRAGMENT_SHADER), spriteVertexShader),
+            makeShaderProgram(loadShaderDir(sprite_array_frag_shader, GL_FRAGMENT_SHADER), spriteVertexShader),
+            makeShaderProgram(loadShaderDir(sprite_indexed_frag_shader, GL_FRAGMENT_SHADER), spriteVertexShader),
+        },
+        [SPRITES_INSTANCED] = {
+            makeShaderProgram(loadShaderDir(simple_frag_shader, GL_FRAGMENT_SHADER), instancedVertexShader),
+            makeShaderProgram(loadShaderDir(sprite_array_layer_frag_shader, GL_FRAGMENT_SHADER), instancedVertexShader),
+            makeShaderProgram(loadShaderDir(sprite_indexed_frag_shader, GL_FRAGMENT_SHADER), instancedVertexShader),
+        },
+        [SPRITES_BATCHED] = {
+            makeShaderProgram(loadShaderDir(simple_frag_shader, GL_FRAGMENT_SHADER), batchedVertexShader),
+            makeShaderProgram(loadShaderDir(sprite_array_layer_frag_shader, GL_FRAGMENT_SHADER), batchedVertexShader),
+            makeShaderProgram(loadShaderDir(sprite_indexed_frag_shader, GL_FRAGMENT_SHADER), batchedVertexShader),
+        },
+    };
     size_t shaderUse = 0;
 
+    GLuint transformUBO;
+    glGenBuffers(1, &transformUBO);
+    for (size_t s = 0; s < sizeof(shaders) / sizeof(shaders[0]); ++s)
+        glUniformBlockBinding(shaders[s], glGetUniformBlockIndex(shaders[s], "Transform"), TRANSFORM_BINDING);
+
+    ringBuffer* ring = useRingBuffer ? ringBufferCreate(RING_FRAME_BYTES) : nullptr;
+    if (useRingBuffer && !ring)
+        printf("No ARB_buffer_storage, per frame data is uploaded through orphaned buffers\n");
+
     setupQuad();
+    spriteRenderer* spriteDrawer = spriteRendererCreate(quadVAO, spriteShaders, ring);
+    if (benchSprites)
+        benchmarkSprites(spriteDrawer, ring, allSprites, suki_sprites, spritesInArrays, premultipliedSprites);
+    drawList* drawKeys = drawListCreate();
+    batchBuilder* batches = batchBuilderCreate(MERGE_CELL_SIZE);
+    bool mergeIdentical = true;
+    if (verifyMerge)
+        mergeIdentical = verifySpriteMerge(spriteDrawer, ring, allSprites, suki_sprites, spritesInArrays, premultipliedSprites, drawKeys, batches);
 
     changeShader(shaders, shaderUse = 0, (float)drawBuffer.renderWidth, (float)drawBuffer.renderHeight);
     glBindVertexArray(quadVAO);
@@ -485,11 +1639,14 @@ int main(const int argc, char **argv)
     double deltaTime = 0.0;
 
     double fpsTimer = 0.0;
+    double worstFrame = 0.0;
     int frameCount = 0;
 
-    int running = 1;
+    int running = !verifyMerge; // --verify-merge only runs the check, and exits with its result
 
     bool freezeSprites = false;
+    float spriteModels[SPRITE_COUNT][16];
+    Uint64 orderTime = 0;
 
     while (running) {
         Uint64 current_counter = SDL_GetPerformanceCounter();
@@ -498,6 +1655,44 @@ int main(const int argc, char **argv)
 
         fpsTimer += deltaTime;
         frameCount++;
+        if (deltaTime > worstFrame)
+            worstFrame = deltaTime;
+
+        if (stream) {
+            textureStreamUpdate(stream, false);
+            if (textureStreamFinished(stream)) {
+                const double ms = (double)(SDL_GetPerformanceCounter() - loadStart) * 1000.0 / (double)perf_freq;
+                size_t duplicates, duplicateBytes;
+                textureStreamDuplicates(stream, &duplicates, &duplicateBytes);
+                printf("Streamed %zu textures in %.2f ms (%zu failed, %zu duplicates sharing a texture, %.1f MiB saved)\n",
+                       suki_sprites, ms, textureStreamFailures(stream), duplicates, duplicateBytes / (1024.0 * 1024.0));
+                if (AssetManifest) {
+                    size_t predicted, mispredicted;
+                    textureStreamPredictions(stream, &predicted, &mispredicted);
+                    printf("  %zu uploads filled storage allocated from the manifest, %zu had to respecify it\n", predicted, mispredicted);
+                }
+                textureStreamDestroy(stream);
+                stream = nullptr;
+
+                if (imageCacheEnabled())
+                    reportImageCache();
+                reportTrim(allSprites, suki_sprites, sprites, SPRITE_COUNT);
+                if (scaleAware)
+                    reportLod(allSprites, suki_sprites);
+                if (DecodeFlags & (DECODE_NARROW | DECODE_PALETTE) && !pack)
+                    reportLayouts(allSprites, suki_sprites, images, reportFormats);
+                if (DecodeFlags & DECODE_PALETTE && !pack)
+                    reportPalettes(allSprites, suki_sprites, images);
+                spritesInArrays = buildSpriteStorage(storage, allSprites, suki_sprites, storageParam, sprites, SPRITE_COUNT);
+                residency = startTextureCache(allSprites, suki_sprites, storage, vramBudget, scaleAware, uploadBudget, pack, decodeThreads);
+            }
+            CHECK_GL_ERRORS();
+        }
+        if (residency) {
+            textureCacheSetReserved(residency, renderTargetBytes(&drawBuffer));
+            textureCacheUpdate(residency);
+            CHECK_GL_ERRORS();
+        }
 
         SDL_Event ev;
         while (SDL_PollEvent(&ev)) {
@@ -519,6 +1714,14 @@ int main(const int argc, char **argv)
                     case SDLK_F:
                         freezeSprites = !freezeSprites;
                         break;
+                    case SDLK_S:
+                        drawOrder = (spriteOrder)((drawOrder + 1) % ORDER_COUNT);
+                        printf("Sprites drawn in %s order\n", spriteOrderName(drawOrder));
+                        break;
+                    case SDLK_I:
+                        renderPath = (spritePath)((renderPath + 1) % SPRITE_PATH_COUNT);
+                        printf("Drawing sprites %s\n", spritePathName(renderPath));
+                        break;
                     case SDLK_F1:
                         createFBOs(&drawBuffer, &msaaFBO, 1280, 720);
                         printf("Rendering game at 1280x720\n");
@@ -585,11 +1788,17 @@ int main(const int argc, char **argv)
         CHECK_GL_ERRORS();
 
 
-        changeShader(shaders, 0, drawBuffer.renderWidth, drawBuffer.renderHeight);
+        if (ring)
+            ringBufferBeginFrame(ring);
+        float projection[16];
+        createOrthographicMatrix(projection, 0, drawBuffer.renderWidth, 0, drawBuffer.renderHeight, -1.0f, 1.0f);
+        glBlendFunc(premultipliedSprites ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        int i = 0;
-        for (int j = 0; j < SPRITE_COUNT; ++j) {
-            glBindTexture(GL_TEXTURE_2D, sprites[i].texture.textureID);
+        spriteRendererBegin(spriteDrawer, renderPath, projection, spritesInArrays);
+        for (int i = 0; i < SPRITE_COUNT; ++i) {
+            if (residency)
+                textureCacheTouch(residency, sprites[i].texture,
+                                  scaleAware ? textureLodForScale(2.0f * sprites[i].scale * GlobalScale) : 0);
             if (!freezeSprites) {
                 sprites[i].x += ((rand() % 2 == 0 ? 1 : -1)) *((rand() % drawBuffer.renderWidth) / 5000.0f - 0.01f) * (float)(deltaTime * 60.0f);
                 if (sprites[i].x > drawBuffer.renderWidth) sprites[i].x = 0;
@@ -600,17 +1809,11 @@ int main(const int argc, char **argv)
                 if (sprites[i].y < 0) sprites[i].y = drawBuffer.renderHeight;
                 sprites[i].rot += ((rand() % 100) / 500.0f - 0.1f) * (float)(deltaTime * 30.0f);
             }
-            float modelMatrix[16];
-            createTransformationMatrix(modelMatrix, sprites[i].x * GlobalScale, sprites[i].y * GlobalScale, sprites[i].texture.width * sprites[i].scale* GlobalScale, -sprites[i].texture.height * sprites[i].scale* GlobalScale, sprites[i].rot);
-
-            const GLint modelLoc = glGetUniformLocation(shaders[shaderUse], "model");
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, modelMatrix);
-
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
-            CHECK_GL_ERRORS();
-
-            i = ++i % SPRITE_COUNT;
+            spriteModelMatrix(spriteModels[i], &sprites[i], GlobalScale);
         }
+        drawSprites(spriteDrawer, sprites, spriteModels, SPRITE_COUNT, drawOrder, spritesInArrays, drawKeys, batches, &orderTime);
+        spriteRendererEnd(spriteDrawer);
+        CHECK_GL_ERRORS();
 
         if (msaaEnabled) {
             glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFBO.bufferId);
@@ -624,6 +1827,7 @@ int main(const int argc, char **argv)
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         glBindTexture(GL_TEXTURE_2D, drawBuffer.colorTexture);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         CHECK_GL_ERRORS();
 
         int viewportX, viewportY, viewportWidth, viewportHeight;
@@ -632,13 +1836,11 @@ int main(const int argc, char **argv)
         changeShader(shaders, shaderUse, viewportWidth, viewportHeight);
         glViewport(viewportX, viewportY, viewportWidth, viewportHeight);
 
-        float modelMatrix[16];
-        createTransformationMatrix(modelMatrix, 0, 0, viewportWidth, viewportHeight, 0);
-        const GLint modelLoc = glGetUniformLocation(shaders[shaderUse], "model");
-        if (modelLoc != -1)
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, modelMatrix);
-        else
-            fprintf(stderr, "modelLoc not found");
+        // Transform: model, then projection
+        float transform[32];
+        createTransformationMatrix(transform, 0, 0, viewportWidth, viewportHeight, 0);
+        createOrthographicMatrix(transform + 16, 0, viewportWidth, 0, viewportHeight, -1.0f, 1.0f);
+        bindFrameUniforms(ring, transformUBO, TRANSFORM_BINDING, transform, sizeof(transform));
 
         if (shaderUse != 0) {
             const GLint texSizeLoc = glGetUniformLocation(shaders[shaderUse], "u_TextureSize");
@@ -649,6 +1851,8 @@ int main(const int argc, char **argv)
 
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
         CHECK_GL_ERRORS();
+        if (ring)
+            ringBufferEndFrame(ring);
 
 
         SDL_GL_SwapWindow(win);
@@ -657,20 +1861,50 @@ int main(const int argc, char **argv)
             double fps = frameCount / fpsTimer;
             char windowTitle[256];
             snprintf(windowTitle, sizeof(windowTitle), "%s FPS: %.2f", title, fps);
-            printf("FPS: %.2f\n", fps);
+            spriteRendererStats spriteStats;
+            spriteRendererGetStats(spriteDrawer, &spriteStats);
+            printf("FPS: %.2f (worst frame %.2f ms, %s sprites: %.1f draw calls, %.1f texture binds/frame)\n", fps, worstFrame * 1000.0,
+                   spritePathName(renderPath), (double)spriteStats.drawCalls / frameCount, (double)spriteStats.textureBinds / frameCount);
             SDL_SetWindowTitle(win, windowTitle);
+            if (residency) {
+                textureCacheStats stats;
+                textureCacheGetStats(residency, &stats);
+                printf("VRAM: %.1f MiB textures (%zu/%zu resident) + %.1f MiB render targets of %.1f MiB, %zu evictions, %zu reloads, %zu promotions\n",
+                       stats.residentBytes / (1024.0 * 1024.0), stats.resident, stats.managed,
+                       stats.reservedBytes / (1024.0 * 1024.0), stats.budgetBytes / (1024.0 * 1024.0),
+                       stats.evictions, stats.reloads, stats.promotions);
+            }
+            if (orderTime)
+                printf("%s draw order: %.3f ms/frame\n", spriteOrderName(drawOrder), (double)orderTime * 1000.0 / (double)perf_freq / frameCount);
+            orderTime = 0;
             frameCount = 0;
             fpsTimer = 0.0;
+            worstFrame = 0.0;
+            spriteRendererResetStats(spriteDrawer);
+            if (ring) {
+                size_t waits, overflows;
+                ringBufferTakeStats(ring, &waits, &overflows);
+                if (waits || overflows)
+                    printf("Ring buffer: %zu frames waited for the GPU, %zu allocations didn't fit\n", waits, overflows);
+            }
         }
     }
     glDeleteTextures(1, &drawBuffer.colorTexture);
     glDeleteFramebuffers(1, &drawBuffer.bufferId);
 
-    free(allSprites);
+    spriteRendererDestroy(spriteDrawer);
+    drawListDestroy(drawKeys);
+    batchBuilderDestroy(batches);
+    ringBufferDestroy(ring);
+    glDeleteBuffers(1, &transformUBO);
+    textureStreamDestroy(stream);
+    textureCacheDestroy(residency);
+    unloadTextures(allSprites, suki_sprites);
+    texturePackClose(pack);
+    imageManifestClose(AssetManifest);
     free(sprites);
-//    glDeleteTextures(suki_sprites, allSprites);
     SDL_GL_DestroyContext(gl_ctx);
     SDL_DestroyWindow(win);
     SDL_Quit();
-    return 0;
+    return mergeIdentical ? 0 : 1;
 }
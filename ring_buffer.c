@@ -0,0 +1,107 @@
+// ring_buffer.c
+#include <stdlib.h>
+
+#include "ring_buffer.h"
+
+struct ringBuffer {
+    GLuint buffer;
+    unsigned char* memory;
+    size_t frameBytes;
+
+    int frame; // region in use
+    size_t cursor; // next free byte of it
+    GLsync fences[RING_FRAMES];
+
+    size_t waits, overflows;
+};
+
+ringBuffer* ringBufferCreate(const size_t frameBytes) {
+    if (!GLAD_GL_ARB_buffer_storage)
+        return nullptr;
+
+    ringBuffer* ring = calloc(1, sizeof(ringBuffer));
+    ring->frameBytes = frameBytes;
+    const GLsizeiptr bytes = (GLsizeiptr)(frameBytes * RING_FRAMES);
+
+    // the copy target, so creating it leaves the array and uniform bindings alone
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &ring->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, flags);
+    ring->memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!ring->memory) {
+        glDeleteBuffers(1, &ring->buffer);
+        free(ring);
+        return nullptr;
+    }
+
+    // nothing is allocated before the first ringBufferBeginFrame
+    ring->frame = RING_FRAMES - 1;
+    ring->cursor = frameBytes;
+    return ring;
+}
+
+static void waitFence(ringBuffer* ring, const int frame) {
+    if (!ring->fences[frame])
+        return;
+    GLenum status = glClientWaitSync(ring->fences[frame], 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        ring->waits++;
+        do {
+            status = glClientWaitSync(ring->fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(ring->fences[frame]);
+    ring->fences[frame] = nullptr;
+}
+
+void ringBufferDestroy(ringBuffer* ring) {
+    if (!ring)
+        return;
+    for (int i = 0; i < RING_FRAMES; ++i)
+        waitFence(ring, i);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &ring->buffer);
+    free(ring);
+}
+
+GLuint ringBufferName(const ringBuffer* ring) {
+    return ring->buffer;
+}
+
+void ringBufferBeginFrame(ringBuffer* ring) {
+    ring->frame = (ring->frame + 1) % RING_FRAMES;
+    waitFence(ring, ring->frame);
+    ring->cursor = 0;
+}
+
+void ringBufferEndFrame(ringBuffer* ring) {
+    if (ring->fences[ring->frame])
+        glDeleteSync(ring->fences[ring->frame]);
+    ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void* ringBufferAlloc(ringBuffer* ring, const size_t size, const size_t alignment, size_t* offset) {
+    const size_t base = (size_t)ring->frame * ring->frameBytes;
+    // aligned as an offset into the whole buffer, which is what gets bound
+    size_t start = base + ring->cursor;
+    if (alignment > 1)
+        start = (start + alignment - 1) / alignment * alignment;
+    if (start + size > base + ring->frameBytes) {
+        ring->overflows++;
+        return nullptr;
+    }
+    ring->cursor = start + size - base;
+    *offset = start;
+    return ring->memory + start;
+}
+
+void ringBufferTakeStats(ringBuffer* ring, size_t* waits, size_t* overflows) {
+    *waits = ring->waits;
+    *overflows = ring->overflows;
+    ring->waits = ring->overflows = 0;
+}
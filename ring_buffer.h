@@ -0,0 +1,38 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+// Per-frame GPU data (instances, vertices, uniform blocks) written straight into a
+// buffer mapped once, persistently and coherently (ARB_buffer_storage). The buffer
+// is split into RING_FRAMES regions: a frame allocates from its own region only,
+// and a region is reused once the fence set at the end of its last frame signals,
+// so the CPU writes while the GPU reads the frames before without orphaning.
+
+#define RING_FRAMES 3
+
+typedef struct ringBuffer ringBuffer;
+
+// frameBytes per region. nullptr without ARB_buffer_storage
+ringBuffer* ringBufferCreate(size_t frameBytes);
+// waits for the GPU to finish with every region first
+void ringBufferDestroy(ringBuffer* ring);
+
+// bindable as any buffer target, offsets from ringBufferAlloc are into it
+GLuint ringBufferName(const ringBuffer* ring);
+
+// moves on to the next region, waiting if the GPU still reads it
+void ringBufferBeginFrame(ringBuffer* ring);
+// fences what the frame drew from its region
+void ringBufferEndFrame(ringBuffer* ring);
+
+// size bytes at an offset that is a multiple of alignment (any value, not only powers of two).
+// nullptr when the frame's region is full, the caller has to upload another way then
+void* ringBufferAlloc(ringBuffer* ring, size_t size, size_t alignment, size_t* offset);
+
+// frames that had to wait for their region, and allocations that didn't fit, since the last call
+void ringBufferTakeStats(ringBuffer* ring, size_t* waits, size_t* overflows);
+
+#endif //RING_BUFFER_H
@@ -1,6 +1,7 @@
 #ifndef SHADERS_H
 #define SHADERS_H
 
+// the upscale pass, its Transform block is written per frame (see bindFrameUniforms in main.c)
 const char* norm_vert_shader =
 "#version 330 core\n"
 "\n"
@@ -8,8 +9,10 @@ const char* norm_vert_shader =
 "layout(location = 1) in vec3 aNormal;\n"
 "layout(location = 2) in vec2 aTexCoord;\n"
 "\n"
-"uniform mat4 model;\n"
-"uniform mat4 projection;\n"
+"layout(std140) uniform Transform {\n"
+"    mat4 model;\n"
+"    mat4 projection;\n"
+"};\n"
 "\n"
 "out vec3 FragPos;\n"
 "out vec3 Normal;\n"
@@ -23,6 +26,68 @@ const char* norm_vert_shader =
 "    gl_Position = projection * model * vec4(aPos, 1.0);\n"
 "}\n";
 
+// sprites only sample their own rect of the bound texture, which is the whole of it
+// unless the texture lives on an atlas page
+const char* sprite_vert_shader =
+"#version 330 core\n"
+"\n"
+"layout(location = 0) in vec3 aPos;\n"
+"layout(location = 2) in vec2 aTexCoord;\n"
+"\n"
+"uniform mat4 model;\n"
+"uniform mat4 projection;\n"
+"uniform vec4 u_UVRect;\n"
+"\n"
+"out vec2 v_TexCoord;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    v_TexCoord = mix(u_UVRect.xy, u_UVRect.zw, aTexCoord);\n"
+"    gl_Position = projection * model * vec4(aPos, 1.0);\n"
+"}\n";
+
+// the same for instanced sprites, see sprite_renderer.c for the instance layout
+const char* sprite_instanced_vert_shader =
+"#version 330 core\n"
+"\n"
+"layout(location = 0) in vec3 aPos;\n"
+"layout(location = 2) in vec2 aTexCoord;\n"
+"layout(location = 3) in vec4 aAxes;\n"
+"layout(location = 4) in vec4 aOrigin;\n"
+"layout(location = 5) in vec4 aUVRect;\n"
+"\n"
+"uniform mat4 projection;\n"
+"\n"
+"out vec2 v_TexCoord;\n"
+"flat out float v_Layer;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    v_TexCoord = mix(aUVRect.xy, aUVRect.zw, aTexCoord);\n"
+"    v_Layer = aOrigin.z;\n"
+"    vec2 pos = aAxes.xy * aPos.x + aAxes.zw * aPos.y + aOrigin.xy;\n"
+"    gl_Position = projection * vec4(pos, 0.0, 1.0);\n"
+"}\n";
+
+// sprites the CPU already put on screen, see the batched path in sprite_renderer.c
+const char* sprite_batched_vert_shader =
+"#version 330 core\n"
+"\n"
+"layout(location = 0) in vec2 aPos;\n"
+"layout(location = 1) in vec3 aTexCoordLayer;\n"
+"\n"
+"uniform mat4 projection;\n"
+"\n"
+"out vec2 v_TexCoord;\n"
+"flat out float v_Layer;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    v_TexCoord = aTexCoordLayer.xy;\n"
+"    v_Layer = aTexCoordLayer.z;\n"
+"    gl_Position = projection * vec4(aPos, 0.0, 1.0);\n"
+"}\n";
+
 const char* bicubic_frag_shader =
 "#version 330 core\n"
 "\n"
@@ -367,6 +432,60 @@ const char* adaptive_sharpen_frag_shader =
 "    FragColor = center + (center - blur) * adaptiveSharpness;\n"
 "}\n";
 
+const char* sprite_array_frag_shader =
+"#version 330 core\n"
+"\n"
+"uniform sampler2DArray u_Texture;\n"
+"uniform float u_Layer;\n"
+"in vec2 v_TexCoord;\n"
+"\n"
+"out vec4 FragColor;\n"
+"\n"
+"void main() {\n"
+"    FragColor = texture(u_Texture, vec3(v_TexCoord, u_Layer));\n"
+"}\n";
+
+// array sprites of the instanced and batched paths, the layer comes with the vertex
+const char* sprite_array_layer_frag_shader =
+"#version 330 core\n"
+"\n"
+"uniform sampler2DArray u_Texture;\n"
+"in vec2 v_TexCoord;\n"
+"flat in float v_Layer;\n"
+"\n"
+"out vec4 FragColor;\n"
+"\n"
+"void main() {\n"
+"    FragColor = texture(u_Texture, vec3(v_TexCoord, v_Layer));\n"
+"}\n";
+
+// PIXEL_INDEXED8 sprites: indices can't be filtered, so the four nearest texels are
+// looked up in the palette and blended by hand, same result as GL_LINEAR on the colours
+const char* sprite_indexed_frag_shader =
+"#version 330 core\n"
+"\n"
+"uniform sampler2D u_Texture;\n"
+"uniform sampler2D u_Palette;\n"
+"in vec2 v_TexCoord;\n"
+"\n"
+"out vec4 FragColor;\n"
+"\n"
+"vec4 paletteAt(ivec2 texel, ivec2 size) {\n"
+"    texel = clamp(texel, ivec2(0), size - 1);\n"
+"    int index = int(texelFetch(u_Texture, texel, 0).r * 255.0 + 0.5);\n"
+"    return texelFetch(u_Palette, ivec2(index, 0), 0);\n"
+"}\n"
+"\n"
+"void main() {\n"
+"    ivec2 size = textureSize(u_Texture, 0);\n"
+"    vec2 coord = v_TexCoord * vec2(size) - 0.5;\n"
+"    ivec2 base = ivec2(floor(coord));\n"
+"    vec2 f = coord - floor(coord);\n"
+"    vec4 top = mix(paletteAt(base, size), paletteAt(base + ivec2(1, 0), size), f.x);\n"
+"    vec4 bottom = mix(paletteAt(base + ivec2(0, 1), size), paletteAt(base + ivec2(1, 1), size), f.x);\n"
+"    FragColor = mix(top, bottom, f.y);\n"
+"}\n";
+
 const char* simple_frag_shader =
 "#version 330 core\n"
 "\n"
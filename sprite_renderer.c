@@ -0,0 +1,358 @@
+// sprite_renderer.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "sprite_renderer.h"
+
+// one per sprite with SPRITES_INSTANCED, read with a divisor of 1:
+//   location 3  vec4 axes    model columns 0 and 1 (xy of each)
+//   location 4  vec4 origin  model translation in xy, array layer in z
+//   location 5  vec4 uvRect
+typedef struct {
+    float axes[4];
+    float origin[4];
+    float uvRect[4];
+} spriteInstance;
+
+// with SPRITES_BATCHED, four per sprite, already on screen:
+//   location 0  vec2 position
+//   location 1  vec3 uv, array layer
+typedef struct {
+    float x, y;
+    float u, v, layer;
+} spriteVertex;
+
+// quads per batched draw, the index buffer holds this many
+#define BATCH_QUADS 2048
+// vertices the streaming buffer holds before it is orphaned
+#define BATCH_BUFFER_VERTICES (BATCH_QUADS * 4 * 8)
+
+// the quad corners of setupQuad, in the same order so the same indices apply
+static const float quadCorners[4][4] = {
+    { 1.0f, 1.0f, 1.0f, 1.0f },
+    { -1.0f, 1.0f, 0.0f, 1.0f },
+    { -1.0f, -1.0f, 0.0f, 0.0f },
+    { 1.0f, -1.0f, 1.0f, 0.0f },
+};
+
+// consecutive sprites that can share one instanced draw
+typedef struct {
+    int program;
+    GLuint textureID, paletteID;
+    size_t first, count;
+} spriteRun;
+
+struct spriteRenderer {
+    GLuint vao;
+    ringBuffer* ring; // may be nullptr
+    GLuint programs[SPRITE_PATH_COUNT][SPRITE_PROGRAM_COUNT];
+    GLint projectionLoc[SPRITE_PATH_COUNT][SPRITE_PROGRAM_COUNT];
+    GLint modelLoc[SPRITE_PROGRAM_COUNT], uvLoc[SPRITE_PROGRAM_COUNT], layerLoc;
+
+    GLuint instanceBuffer;
+    size_t instanceCap; // of the GL buffer
+    spriteInstance* instances;
+    size_t instancec, instancesCap;
+    spriteRun* runs;
+    size_t runc, runCap;
+
+    GLuint batchVAO, batchBuffer, batchIndices;
+    GLuint batchSource; // the buffer batchVAO's attributes read, batchBuffer or the ring
+    size_t batchCursor; // next free vertex in batchBuffer
+    spriteVertex vertices[BATCH_QUADS * 4]; // the batch being built
+    size_t quadc;
+    spriteRun batch; // its state, first and count unused
+
+    spritePath path;
+    bool arrays;
+    int program; // in use, -1 before the first sprite of a frame
+    GLuint boundTexture, boundPalette;
+    spriteRendererStats stats;
+};
+
+// base is the byte offset of the first instance in the bound GL_ARRAY_BUFFER
+static void setInstanceAttributes(const size_t base) {
+    const GLsizei stride = sizeof(spriteInstance);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(spriteInstance, axes)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(spriteInstance, origin)));
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(spriteInstance, uvRect)));
+}
+
+static void setBatchSource(spriteRenderer* renderer, const GLuint buffer) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (renderer->batchSource == buffer)
+        return;
+    renderer->batchSource = buffer;
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(spriteVertex), (void*)offsetof(spriteVertex, x));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(spriteVertex), (void*)offsetof(spriteVertex, u));
+}
+
+spriteRenderer* spriteRendererCreate(const GLuint quadVAO, const GLuint programs[SPRITE_PATH_COUNT][SPRITE_PROGRAM_COUNT],
+                                     ringBuffer* ring) {
+    spriteRenderer* renderer = calloc(1, sizeof(spriteRenderer));
+    renderer->vao = quadVAO;
+    renderer->ring = ring;
+    memcpy(renderer->programs, programs, sizeof(renderer->programs));
+
+    for (int p = 0; p < SPRITE_PROGRAM_COUNT; ++p) {
+        renderer->modelLoc[p] = glGetUniformLocation(programs[SPRITES_PER_DRAW][p], "model");
+        renderer->uvLoc[p] = glGetUniformLocation(programs[SPRITES_PER_DRAW][p], "u_UVRect");
+    }
+    renderer->layerLoc = glGetUniformLocation(programs[SPRITES_PER_DRAW][SPRITE_PROGRAM_ARRAY], "u_Layer");
+
+    // palettes always sit on unit 1, indices on unit 0 like every other sprite texture
+    for (int path = 0; path < SPRITE_PATH_COUNT; ++path) {
+        for (int p = 0; p < SPRITE_PROGRAM_COUNT; ++p)
+            renderer->projectionLoc[path][p] = glGetUniformLocation(programs[path][p], "projection");
+        glUseProgram(programs[path][SPRITE_PROGRAM_INDEXED]);
+        glUniform1i(glGetUniformLocation(programs[path][SPRITE_PROGRAM_INDEXED], "u_Palette"), 1);
+    }
+
+    // the attributes stay enabled, other draws on the VAO just read instance 0 and ignore it
+    renderer->instanceCap = 1024;
+    glBindVertexArray(quadVAO);
+    glGenBuffers(1, &renderer->instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, renderer->instanceCap * sizeof(spriteInstance), nullptr, GL_STREAM_DRAW);
+    setInstanceAttributes(0);
+    for (GLuint a = 3; a <= 5; ++a) {
+        glVertexAttribDivisor(a, 1);
+        glEnableVertexAttribArray(a);
+    }
+
+    renderer->batchCursor = BATCH_BUFFER_VERTICES;
+    glGenVertexArrays(1, &renderer->batchVAO);
+    glBindVertexArray(renderer->batchVAO);
+    glGenBuffers(1, &renderer->batchBuffer);
+    setBatchSource(renderer, renderer->batchBuffer);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    GLuint* indices = malloc(sizeof(GLuint) * BATCH_QUADS * 6);
+    for (GLuint q = 0; q < BATCH_QUADS; ++q) {
+        static const GLuint quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < 6; ++i)
+            indices[q * 6 + i] = q * 4 + quad[i];
+    }
+    glGenBuffers(1, &renderer->batchIndices);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->batchIndices);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * BATCH_QUADS * 6, indices, GL_STATIC_DRAW);
+    free(indices);
+
+    glBindVertexArray(quadVAO);
+    return renderer;
+}
+
+void spriteRendererDestroy(spriteRenderer* renderer) {
+    if (!renderer)
+        return;
+    glDeleteBuffers(1, &renderer->instanceBuffer);
+    glDeleteVertexArrays(1, &renderer->batchVAO);
+    glDeleteBuffers(1, &renderer->batchBuffer);
+    glDeleteBuffers(1, &renderer->batchIndices);
+    free(renderer->instances);
+    free(renderer->runs);
+    free(renderer);
+}
+
+const char* spritePathName(const spritePath path) {
+    switch (path) {
+        case SPRITES_PER_DRAW: return "per-sprite";
+        case SPRITES_INSTANCED: return "instanced";
+        case SPRITES_BATCHED: return "batched";
+        default: return "?";
+    }
+}
+
+void spriteRendererBegin(spriteRenderer* renderer, const spritePath path, const float* projection, const bool arrays) {
+    renderer->path = path;
+    renderer->arrays = arrays;
+    renderer->program = -1;
+    renderer->boundTexture = renderer->boundPalette = 0;
+    renderer->instancec = renderer->runc = 0;
+    renderer->quadc = 0;
+
+    for (int p = 0; p < SPRITE_PROGRAM_COUNT; ++p) {
+        glUseProgram(renderer->programs[path][p]);
+        glUniformMatrix4fv(renderer->projectionLoc[path][p], 1, GL_FALSE, projection);
+    }
+    glBindVertexArray(path == SPRITES_BATCHED ? renderer->batchVAO : renderer->vao);
+}
+
+int spriteProgramFor(const texture* tex, const bool arrays) {
+    // a placeholder is plain RGBA8 whatever its layout says
+    if (arrays)
+        return SPRITE_PROGRAM_ARRAY;
+    return tex->layout == PIXEL_INDEXED8 && tex->ready ? SPRITE_PROGRAM_INDEXED : SPRITE_PROGRAM_PLAIN;
+}
+
+static void bindState(spriteRenderer* renderer, const int program, const GLuint textureID, const GLuint paletteID) {
+    if (program != renderer->program) {
+        glUseProgram(renderer->programs[renderer->path][program]);
+        renderer->program = program;
+        renderer->stats.programChanges++;
+    }
+    if (program == SPRITE_PROGRAM_INDEXED && paletteID != renderer->boundPalette) {
+        renderer->boundPalette = paletteID;
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, paletteID);
+        glActiveTexture(GL_TEXTURE0);
+        renderer->stats.textureBinds++;
+    }
+    // atlased or layered sprites mostly share a texture with the one before
+    if (textureID != renderer->boundTexture) {
+        renderer->boundTexture = textureID;
+        glBindTexture(renderer->arrays ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, textureID);
+        renderer->stats.textureBinds++;
+    }
+}
+
+static void flushBatch(spriteRenderer* renderer) {
+    if (renderer->quadc == 0)
+        return;
+
+    const size_t vertexc = renderer->quadc * 4;
+    const size_t bytes = vertexc * sizeof(spriteVertex);
+
+    // the ring region is vertex aligned, so the offset is a whole number of vertices
+    size_t offset;
+    void* mapped = renderer->ring ? ringBufferAlloc(renderer->ring, bytes, sizeof(spriteVertex), &offset) : nullptr;
+    GLint baseVertex;
+    if (mapped) {
+        memcpy(mapped, renderer->vertices, bytes);
+        setBatchSource(renderer, ringBufferName(renderer->ring));
+        baseVertex = (GLint)(offset / sizeof(spriteVertex));
+    } else {
+        // appended behind the draws already made from the buffer, so nothing waits on them;
+        // only a full buffer is orphaned
+        setBatchSource(renderer, renderer->batchBuffer);
+        if (renderer->batchCursor + vertexc > BATCH_BUFFER_VERTICES) {
+            glBufferData(GL_ARRAY_BUFFER, BATCH_BUFFER_VERTICES * sizeof(spriteVertex), nullptr, GL_STREAM_DRAW);
+            renderer->batchCursor = 0;
+        }
+        mapped = glMapBufferRange(GL_ARRAY_BUFFER, renderer->batchCursor * sizeof(spriteVertex), bytes,
+                                  GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (mapped) {
+            memcpy(mapped, renderer->vertices, bytes);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, renderer->batchCursor * sizeof(spriteVertex), bytes, renderer->vertices);
+        }
+        baseVertex = (GLint)renderer->batchCursor;
+        renderer->batchCursor += vertexc;
+    }
+
+    bindState(renderer, renderer->batch.program, renderer->batch.textureID, renderer->batch.paletteID);
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)(renderer->quadc * 6), GL_UNSIGNED_INT, nullptr, baseVertex);
+    renderer->stats.drawCalls++;
+    renderer->quadc = 0;
+}
+
+static void batchSprite(spriteRenderer* renderer, const int program, const GLuint paletteID, const texture* tex, const float* model) {
+    const spriteRun* b = &renderer->batch;
+    if (renderer->quadc == BATCH_QUADS || (renderer->quadc && (b->program != program || b->textureID != tex->textureID || b->paletteID != paletteID)))
+        flushBatch(renderer);
+    renderer->batch = (spriteRun){ program, tex->textureID, paletteID, 0, 0 };
+
+    spriteVertex* v = &renderer->vertices[renderer->quadc++ * 4];
+    const float* uv = tex->uvRect;
+    for (int i = 0; i < 4; ++i) {
+        const float* c = quadCorners[i];
+        v[i] = (spriteVertex){
+            model[0] * c[0] + model[4] * c[1] + model[12],
+            model[1] * c[0] + model[5] * c[1] + model[13],
+            uv[0] + (uv[2] - uv[0]) * c[2],
+            uv[1] + (uv[3] - uv[1]) * c[3],
+            (float)tex->arrayLayer,
+        };
+    }
+}
+
+void spriteRendererDraw(spriteRenderer* renderer, const texture* tex, const float* model) {
+    const int program = spriteProgramFor(tex, renderer->arrays);
+    renderer->stats.sprites++;
+
+    if (renderer->path == SPRITES_PER_DRAW) {
+        bindState(renderer, program, tex->textureID, tex->paletteID);
+        if (renderer->arrays)
+            glUniform1f(renderer->layerLoc, (float)tex->arrayLayer);
+        glUniformMatrix4fv(renderer->modelLoc[program], 1, GL_FALSE, model);
+        glUniform4fv(renderer->uvLoc[program], 1, tex->uvRect);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+        renderer->stats.drawCalls++;
+        return;
+    }
+
+    const GLuint paletteID = program == SPRITE_PROGRAM_INDEXED ? tex->paletteID : 0;
+    if (renderer->path == SPRITES_BATCHED) {
+        batchSprite(renderer, program, paletteID, tex, model);
+        return;
+    }
+
+    if (renderer->instancec == renderer->instancesCap) {
+        renderer->instancesCap = renderer->instancesCap ? renderer->instancesCap * 2 : 1024;
+        renderer->instances = realloc(renderer->instances, sizeof(spriteInstance) * renderer->instancesCap);
+    }
+    spriteInstance* instance = &renderer->instances[renderer->instancec++];
+    *instance = (spriteInstance){
+        .axes = { model[0], model[1], model[4], model[5] },
+        .origin = { model[12], model[13], (float)tex->arrayLayer, 0.0f },
+        .uvRect = { tex->uvRect[0], tex->uvRect[1], tex->uvRect[2], tex->uvRect[3] },
+    };
+
+    spriteRun* run = renderer->runc ? &renderer->runs[renderer->runc - 1] : nullptr;
+    if (run && run->program == program && run->textureID == tex->textureID && run->paletteID == paletteID) {
+        run->count++;
+        return;
+    }
+    if (renderer->runc == renderer->runCap) {
+        renderer->runCap = renderer->runCap ? renderer->runCap * 2 : 64;
+        renderer->runs = realloc(renderer->runs, sizeof(spriteRun) * renderer->runCap);
+    }
+    renderer->runs[renderer->runc++] = (spriteRun){ program, tex->textureID, paletteID, renderer->instancec - 1, 1 };
+}
+
+void spriteRendererEnd(spriteRenderer* renderer) {
+    if (renderer->path == SPRITES_BATCHED) {
+        flushBatch(renderer);
+        glBindVertexArray(renderer->vao);
+        return;
+    }
+    if (renderer->path != SPRITES_INSTANCED || renderer->instancec == 0)
+        return;
+
+    // one upload for the frame: into the ring, or else orphaned so it never waits on the last frame's draws
+    const size_t bytes = renderer->instancec * sizeof(spriteInstance);
+    size_t base = 0;
+    void* mapped = renderer->ring ? ringBufferAlloc(renderer->ring, bytes, sizeof(spriteInstance), &base) : nullptr;
+    if (mapped) {
+        memcpy(mapped, renderer->instances, bytes);
+        glBindBuffer(GL_ARRAY_BUFFER, ringBufferName(renderer->ring));
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, renderer->instanceBuffer);
+        while (renderer->instanceCap < renderer->instancec)
+            renderer->instanceCap *= 2;
+        glBufferData(GL_ARRAY_BUFFER, renderer->instanceCap * sizeof(spriteInstance), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, renderer->instances);
+    }
+
+    // no base instance in GL 3.3, each run points the attributes at its own first instance
+    for (size_t i = 0; i < renderer->runc; ++i) {
+        const spriteRun* run = &renderer->runs[i];
+        bindState(renderer, run->program, run->textureID, run->paletteID);
+        setInstanceAttributes(base + run->first * sizeof(spriteInstance));
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (GLsizei)run->count);
+        renderer->stats.drawCalls++;
+    }
+    // back to a buffer that is always there for the plain draws on the VAO
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->instanceBuffer);
+    setInstanceAttributes(0);
+}
+
+void spriteRendererGetStats(const spriteRenderer* renderer, spriteRendererStats* stats) {
+    *stats = renderer->stats;
+}
+
+void spriteRendererResetStats(spriteRenderer* renderer) {
+    renderer->stats = (spriteRendererStats){ 0 };
+}
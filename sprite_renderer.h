@@ -0,0 +1,74 @@
+#ifndef SPRITE_RENDERER_H
+#define SPRITE_RENDERER_H
+
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+#include "texture.h"
+#include "ring_buffer.h"
+
+// Draws sprites between spriteRendererBegin and spriteRendererEnd, one textured
+// quad per spriteRendererDraw in submission order. How they reach the GPU is
+// picked per frame so the paths can be compared:
+//   SPRITES_PER_DRAW   a model matrix and uv rect uniform and a glDrawElements per sprite
+//   SPRITES_INSTANCED  transforms, uv rects and array layers go into an instance buffer,
+//                      uploaded once at spriteRendererEnd, and every run of sprites
+//                      sharing a texture (atlas page, array) and program is a single
+//                      glDrawElementsInstanced on the quad VAO
+//   SPRITES_BATCHED    sprites are transformed on the CPU into four vertices each, appended
+//                      to a streaming vertex buffer, and drawn with one glDrawElements per
+//                      texture or program change. no instanced attributes, for drivers
+//                      where those are slow
+
+typedef enum {
+    SPRITES_PER_DRAW,
+    SPRITES_INSTANCED,
+    SPRITES_BATCHED,
+    SPRITE_PATH_COUNT
+} spritePath;
+
+// which fragment shader a sprite needs
+enum {
+    SPRITE_PROGRAM_PLAIN,   // sampler2D
+    SPRITE_PROGRAM_ARRAY,   // sampler2DArray, the layer comes from u_Layer or the instance
+    SPRITE_PROGRAM_INDEXED, // PIXEL_INDEXED8 with its palette on unit 1
+    SPRITE_PROGRAM_COUNT
+};
+
+// the program tex is drawn with
+int spriteProgramFor(const texture* tex, bool arrays);
+
+typedef struct spriteRenderer spriteRenderer;
+
+typedef struct {
+    size_t sprites;
+    size_t drawCalls;
+    size_t textureBinds; // palettes included
+    size_t programChanges;
+} spriteRendererStats;
+
+// programs[path][program], those of SPRITES_PER_DRAW take model and u_UVRect uniforms,
+// those of SPRITES_INSTANCED the instance attributes at locations 3 to 5 and those of SPRITES_BATCHED
+// screen space vertices at locations 0 and 1 (see sprite_renderer.c).
+// the instance attributes are added to quadVAO, which has to have the quad at locations 0 and 2.
+// with a ring (may be nullptr) instances and batched vertices are written into the current
+// frame's region, the caller begins and ends the ring's frames around the sprites
+spriteRenderer* spriteRendererCreate(GLuint quadVAO, const GLuint programs[SPRITE_PATH_COUNT][SPRITE_PROGRAM_COUNT],
+                                     ringBuffer* ring);
+void spriteRendererDestroy(spriteRenderer* renderer);
+
+// projection is a 4x4 column major matrix. arrays: every sprite samples a GL_TEXTURE_2D_ARRAY layer.
+// leaves quadVAO bound and the program of the last sprite in use
+void spriteRendererBegin(spriteRenderer* renderer, spritePath path, const float* projection, bool arrays);
+// model is the 4x4 column major matrix that puts the -1..1 quad on screen
+void spriteRendererDraw(spriteRenderer* renderer, const texture* tex, const float* model);
+void spriteRendererEnd(spriteRenderer* renderer);
+
+// totals since the last reset
+void spriteRendererGetStats(const spriteRenderer* renderer, spriteRendererStats* stats);
+void spriteRendererResetStats(spriteRenderer* renderer);
+
+const char* spritePathName(spritePath path);
+
+#endif //SPRITE_RENDERER_H
@@ -0,0 +1,169 @@
+// staging_buffer.c
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include "staging_buffer.h"
+
+typedef struct {
+    size_t first, count;
+} chunkRun;
+
+// releases waiting on one fence, oldest first
+typedef struct fencedRuns {
+    GLsync fence;
+    chunkRun* runs;
+    size_t runc;
+    struct fencedRuns* next;
+} fencedRuns;
+
+struct stagingBuffer {
+    GLuint buffer;
+    unsigned char* memory;
+    size_t chunks;
+
+    SDL_Mutex* lock; // guards used and searchStart, the rest is the GL thread's
+    unsigned char* used;
+    size_t searchStart;
+
+    chunkRun* released; // since the last fence
+    size_t releasedc, releasedCap;
+    fencedRuns *head, *tail;
+};
+
+stagingBuffer* stagingBufferCreate(const size_t size) {
+    if (!GLAD_GL_ARB_buffer_storage)
+        return nullptr;
+
+    stagingBuffer* staging = calloc(1, sizeof(stagingBuffer));
+    staging->chunks = (size + STAGING_CHUNK - 1) / STAGING_CHUNK;
+    const size_t bytes = staging->chunks * STAGING_CHUNK;
+
+    // coherent, so a decode thread's writes are visible without a flush once the GL thread sees the result
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &staging->buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)bytes, nullptr, flags);
+    staging->memory = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!staging->memory) {
+        glDeleteBuffers(1, &staging->buffer);
+        free(staging);
+        return nullptr;
+    }
+
+    staging->lock = SDL_CreateMutex();
+    staging->used = calloc(staging->chunks, 1);
+    return staging;
+}
+
+static void freeRuns(stagingBuffer* staging, const chunkRun* runs, const size_t runc) {
+    SDL_LockMutex(staging->lock);
+    for (size_t i = 0; i < runc; ++i)
+        memset(staging->used + runs[i].first, 0, runs[i].count);
+    SDL_UnlockMutex(staging->lock);
+}
+
+static void retire(stagingBuffer* staging, const GLuint64 timeout) {
+    while (staging->head) {
+        fencedRuns* f = staging->head;
+        const GLenum status = glClientWaitSync(f->fence, timeout ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        freeRuns(staging, f->runs, f->runc);
+        glDeleteSync(f->fence);
+        staging->head = f->next;
+        if (!staging->head)
+            staging->tail = nullptr;
+        free(f->runs);
+        free(f);
+    }
+}
+
+void stagingBufferDestroy(stagingBuffer* staging) {
+    if (!staging)
+        return;
+
+    // the GPU may still be reading, it has to finish before the memory goes
+    stagingBufferFence(staging);
+    retire(staging, UINT64_MAX);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->buffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &staging->buffer);
+
+    SDL_DestroyMutex(staging->lock);
+    free(staging->used);
+    free(staging->released);
+    free(staging);
+}
+
+GLuint stagingBufferName(const stagingBuffer* staging) {
+    return staging->buffer;
+}
+
+bool stagingBufferAlloc(stagingBuffer* staging, const size_t size, size_t* offset, unsigned char** memory) {
+    const size_t need = (size + STAGING_CHUNK - 1) / STAGING_CHUNK;
+    if (need == 0 || need > staging->chunks)
+        return false;
+
+    // next fit, wrapping around once
+    SDL_LockMutex(staging->lock);
+    size_t found = SIZE_MAX;
+    size_t start = staging->searchStart;
+    for (size_t scanned = 0; scanned < staging->chunks && found == SIZE_MAX;) {
+        if (start + need > staging->chunks) {
+            scanned += staging->chunks - start;
+            start = 0;
+            continue;
+        }
+        size_t run = 0;
+        while (run < need && !staging->used[start + run])
+            run++;
+        if (run == need)
+            found = start;
+        else {
+            scanned += run + 1;
+            start += run + 1;
+        }
+    }
+    if (found != SIZE_MAX) {
+        memset(staging->used + found, 1, need);
+        staging->searchStart = (found + need) % staging->chunks;
+    }
+    SDL_UnlockMutex(staging->lock);
+
+    if (found == SIZE_MAX)
+        return false;
+    *offset = found * STAGING_CHUNK;
+    *memory = staging->memory + *offset;
+    return true;
+}
+
+void stagingBufferRelease(stagingBuffer* staging, const size_t offset, const size_t size) {
+    if (staging->releasedc == staging->releasedCap) {
+        staging->releasedCap = staging->releasedCap ? staging->releasedCap * 2 : 64;
+        staging->released = realloc(staging->released, sizeof(chunkRun) * staging->releasedCap);
+    }
+    staging->released[staging->releasedc++] = (chunkRun){ offset / STAGING_CHUNK, (size + STAGING_CHUNK - 1) / STAGING_CHUNK };
+}
+
+void stagingBufferFence(stagingBuffer* staging) {
+    if (staging->releasedc) {
+        fencedRuns* f = calloc(1, sizeof(fencedRuns));
+        f->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        f->runs = staging->released;
+        f->runc = staging->releasedc;
+        if (staging->tail)
+            staging->tail->next = f;
+        else
+            staging->head = f;
+        staging->tail = f;
+
+        staging->released = nullptr;
+        staging->releasedc = staging->releasedCap = 0;
+    }
+    retire(staging, 0);
+}
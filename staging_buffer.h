@@ -0,0 +1,32 @@
+#ifndef STAGING_BUFFER_H
+#define STAGING_BUFFER_H
+
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+// A pixel unpack buffer mapped once, persistently and coherently (ARB_buffer_storage),
+// that decode threads copy finished images into so the GL thread uploads straight
+// from it with no copy of its own. Space is handed out in STAGING_CHUNK pieces from
+// any thread and comes back once a fence shows the GPU has read it.
+
+#define STAGING_CHUNK (16 * 1024)
+
+typedef struct stagingBuffer stagingBuffer;
+
+// GL thread. nullptr without ARB_buffer_storage
+stagingBuffer* stagingBufferCreate(size_t size);
+void stagingBufferDestroy(stagingBuffer* staging);
+
+GLuint stagingBufferName(const stagingBuffer* staging);
+
+// any thread. false when there's no room right now, the caller keeps its own copy then.
+// offset is where *memory sits in the buffer, to use as a GL_PIXEL_UNPACK_BUFFER offset
+bool stagingBufferAlloc(stagingBuffer* staging, size_t size, size_t* offset, unsigned char** memory);
+
+// GL thread. hands an allocation back once every GL command issued so far is done with it
+void stagingBufferRelease(stagingBuffer* staging, size_t offset, size_t size);
+// GL thread. fences the releases since the last call, and frees those whose fence has signalled
+void stagingBufferFence(stagingBuffer* staging);
+
+#endif //STAGING_BUFFER_H
@@ -0,0 +1,81 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+
+#include "image_ops.h"
+
+typedef struct {
+    int width, height; // full image size, sprites are sized by this
+    GLuint textureID;
+    bool ready; // false while a streamed texture still holds its placeholder
+    int trimX, trimY, trimWidth, trimHeight; // the part of the image textureID actually stores
+    int levels; // mip levels stored
+    int lod; // top levels dropped at load, textureID holds the trim rect halved this many times
+    pixelLayout layout; // how textureID stores its texels, swizzled back to RGBA when sampled
+    GLuint paletteID; // 256x1 RGBA8 colours for PIXEL_INDEXED8, 0 otherwise
+    int atlasPage; // -1 unless textureID is a shared atlas page
+    int arrayLayer; // -1 unless textureID is a GL_TEXTURE_2D_ARRAY, then the layer to sample
+    float uvRect[4]; // u0, v0, u1, v1 of the stored rect inside textureID
+} texture;
+
+// a texture that owns the whole of id, nothing trimmed, atlased or layered
+static inline texture makeTexture(const int width, const int height, const GLuint id, const bool ready) {
+    return (texture){
+        .width = width, .height = height,
+        .textureID = id,
+        .ready = ready,
+        .trimWidth = width, .trimHeight = height,
+        .levels = 1,
+        .layout = PIXEL_RGBA8,
+        .atlasPage = -1,
+        .arrayLayer = -1,
+        .uvRect = { 0.0f, 0.0f, 1.0f, 1.0f },
+    };
+}
+
+// only the w x h rect at x, y of a width x height image is stored in id
+static inline texture makeTrimmedTexture(const int width, const int height, const GLuint id, const bool ready,
+                                         const int x, const int y, const int w, const int h) {
+    texture tex = makeTexture(width, height, id, ready);
+    tex.trimX = x;
+    tex.trimY = y;
+    tex.trimWidth = w;
+    tex.trimHeight = h;
+    return tex;
+}
+
+// scale-aware loading never drops more than this many levels, unused images included
+#define MAX_TEXTURE_LOD 4
+
+// size of the stored level 0 for a trimmed size of `size`
+static inline int textureStoredSize(int size, int lod) {
+    while (lod-- > 0 && size > 1)
+        size /= 2;
+    return size;
+}
+
+static inline int textureStoredWidth(const texture* tex) {
+    return textureStoredSize(tex->trimWidth, tex->lod);
+}
+
+static inline int textureStoredHeight(const texture* tex) {
+    return textureStoredSize(tex->trimHeight, tex->lod);
+}
+
+// bytes textureID holds, all levels, plus the palette for indexed textures
+static inline size_t textureBytes(const texture* tex) {
+    return pixelLayoutChainSize(tex->layout, textureStoredWidth(tex), textureStoredHeight(tex), tex->levels) +
+           (tex->layout == PIXEL_INDEXED8 ? PALETTE_BYTES : 0);
+}
+
+// levels that can be dropped when one source texel covers `pixels` screen pixels,
+// the smallest level kept still has at least a texel per pixel
+static inline int textureLodForScale(const float pixels) {
+    int lod = 0;
+    while (lod < MAX_TEXTURE_LOD && pixels * (float)(2 << lod) <= 1.0f)
+        lod++;
+    return lod;
+}
+
+#endif //TEXTURE_H
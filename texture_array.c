@@ -0,0 +1,148 @@
+// texture_array.c
+#include <stdlib.h>
+
+#include "texture_array.h"
+
+typedef struct {
+    size_t index; // first texture using this GL name
+    int w, h;     // bucket size
+} arrayItem;
+
+static int compareItems(const void* a, const void* b) {
+    const arrayItem* l = a;
+    const arrayItem* r = b;
+    if (l->w != r->w)
+        return l->w - r->w;
+    if (l->h != r->h)
+        return l->h - r->h;
+    return l->index < r->index ? -1 : l->index > r->index;
+}
+
+static int levelSize(const int size, const int level) {
+    return size >> level > 1 ? size >> level : 1;
+}
+
+static int roundUp(const int value, const int granularity) {
+    return (value + granularity - 1) / granularity * granularity;
+}
+
+bool textureArrayBuild(texture* textures, const size_t count, int granularity, textureArrayStats* stats) {
+    if (granularity < 1)
+        granularity = 1;
+
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    // textures sharing a GL name (deduplicated ones) only need one layer
+    arrayItem* items = malloc(sizeof(arrayItem) * (count ? count : 1));
+    size_t itemc = 0;
+    *stats = (textureArrayStats){ 0 };
+
+    for (size_t i = 0; i < count; ++i) {
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; ++j)
+            seen = textures[j].textureID == textures[i].textureID;
+        if (seen || textures[i].atlasPage >= 0 || textures[i].arrayLayer >= 0)
+            continue;
+        if (textures[i].layout != PIXEL_RGBA8) {
+            stats->skipped++;
+            continue;
+        }
+
+        items[itemc++] = (arrayItem){
+            i,
+            roundUp(textureStoredWidth(&textures[i]), granularity),
+            roundUp(textureStoredHeight(&textures[i]), granularity),
+        };
+    }
+    qsort(items, itemc, sizeof(arrayItem), compareItems);
+
+    GLuint fbos[2];
+    glGenFramebuffers(2, fbos);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+    glClearColor(0, 0, 0, 0);
+
+    GLuint* retired = malloc(sizeof(GLuint) * (itemc ? itemc : 1));
+
+    for (size_t first = 0; first < itemc;) {
+        const int w = items[first].w, h = items[first].h;
+        size_t last = first;
+        while (last < itemc && items[last].w == w && items[last].h == h)
+            last++;
+        stats->buckets++;
+
+        // a bucket bigger than the layer limit is split over several arrays
+        for (size_t begin = first; begin < last; begin += (size_t)maxLayers) {
+            const size_t layers = last - begin < (size_t)maxLayers ? last - begin : (size_t)maxLayers;
+
+            // every layer gets the same number of levels, as many as the shortest chain among them has
+            int levels = textures[items[begin].index].levels;
+            for (size_t layer = 1; layer < layers; ++layer) {
+                const int l = textures[items[begin + layer].index].levels;
+                levels = l < levels ? l : levels;
+            }
+            levels = levels > 1 ? levels : 1;
+
+            GLuint array;
+            glGenTextures(1, &array);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            for (int level = 0; level < levels; ++level)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, levelSize(w, level), levelSize(h, level), (GLsizei)layers, 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            stats->arrays++;
+
+            for (size_t layer = 0; layer < layers; ++layer) {
+                const arrayItem* item = &items[begin + layer];
+                const texture* src = &textures[item->index];
+                const int srcW = textureStoredWidth(src), srcH = textureStoredHeight(src);
+
+                // the source's own (gamma-correct, cooked) levels are copied, never regenerated
+                for (int level = 0; level < levels; ++level) {
+                    const int levelW = levelSize(srcW, level), levelH = levelSize(srcH, level);
+                    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array, level, (GLint)layer);
+                    if (levelW != levelSize(w, level) || levelH != levelSize(h, level))
+                        glClear(GL_COLOR_BUFFER_BIT);
+
+                    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src->textureID, level);
+                    glBlitFramebuffer(0, 0, levelW, levelH,
+                                      0, 0, levelW, levelH,
+                                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                }
+
+                stats->imageTexels += (size_t)srcW * srcH;
+                stats->paddingTexels += (size_t)w * h - (size_t)srcW * srcH;
+
+                const GLuint oldID = src->textureID;
+                retired[begin + layer] = oldID;
+                for (size_t j = item->index; j < count; ++j) {
+                    texture* tex = &textures[j];
+                    if (tex->textureID != oldID)
+                        continue;
+                    tex->textureID = array;
+                    tex->arrayLayer = (int)layer;
+                    tex->levels = levels;
+                    tex->uvRect[0] = 0.0f;
+                    tex->uvRect[1] = 0.0f;
+                    tex->uvRect[2] = (float)srcW / w;
+                    tex->uvRect[3] = (float)srcH / h;
+                }
+            }
+            stats->layers += layers;
+        }
+        first = last;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(2, fbos);
+    glDeleteTextures(itemc, retired);
+
+    free(retired);
+    free(items);
+    return glGetError() == GL_NO_ERROR;
+}
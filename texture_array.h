@@ -0,0 +1,27 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <stddef.h>
+
+#include "texture.h"
+
+// Alternative to the atlas: loaded textures are grouped by size into
+// GL_TEXTURE_2D_ARRAY objects, one layer per image. Sizes are rounded up to
+// granularity texels to form a bucket, so granularity 1 means exact sizes and no
+// padding at all. Textures are rewritten in place to point at their array and
+// layer and the originals are deleted. Only RGBA8 textures are moved, others
+// (narrow or block compressed) are left alone. Mip levels are copied too, each
+// array keeps as many as the shortest chain among its layers has.
+
+typedef struct {
+    int arrays;
+    int buckets;
+    size_t layers;
+    size_t skipped; // not RGBA8
+    size_t paddingTexels; // texels lost to rounding sizes up to the bucket
+    size_t imageTexels;
+} textureArrayStats;
+
+bool textureArrayBuild(texture* textures, size_t count, int granularity, textureArrayStats* stats);
+
+#endif //TEXTURE_ARRAY_H
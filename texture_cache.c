@@ -0,0 +1,305 @@
+// texture_cache.c
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "texture_cache.h"
+#include "decode_pool.h"
+#include "image_ops.h"
+#include "texture_upload.h"
+#include "stb_image.h"
+
+typedef struct {
+    size_t leader; // first texture with this GL name, the group's state lives on it
+    size_t next;   // next texture in the group, SIZE_MAX ends it
+    GLuint id;     // the real name while resident
+    GLuint palette; // colours of an indexed texture while resident, else 0
+    int levels;
+    pixelLayout layout;
+    size_t bytes;
+    int lod;       // of what is resident, or was before eviction
+    int wantLod;   // for the queued reload
+    long lastUsed;
+    bool managed;
+    bool resident;
+    bool queued;   // reload requested, not uploaded yet
+} cacheEntry;
+
+typedef struct {
+    long lastUsed;
+    size_t leader;
+} evictCandidate;
+
+struct textureCache {
+    texture* textures;
+    cacheEntry* entries;
+    size_t count;
+    GLuint placeholder;
+
+    const texturePack* pack;
+    const char** paths;
+    decodePool* pool; // png reloads, only without a pack
+    size_t* packQueue;
+    size_t packQueued;
+    evictCandidate* candidates;
+
+    size_t budgetBytes, reservedBytes, residentBytes, uploadBudget;
+    size_t resident, managed;
+    size_t evictions, reloads, promotions;
+    long frame;
+    bool warnedOverBudget;
+};
+
+static void setGroup(textureCache* cache, const size_t leader, const GLuint id, const bool ready) {
+    for (size_t i = leader; i != SIZE_MAX; i = cache->entries[i].next) {
+        cache->textures[i].textureID = id;
+        cache->textures[i].ready = ready;
+        cache->textures[i].levels = cache->entries[leader].levels;
+        cache->textures[i].lod = cache->entries[leader].lod;
+        cache->textures[i].layout = cache->entries[leader].layout;
+        cache->textures[i].paletteID = cache->entries[leader].palette;
+    }
+}
+
+static void deleteResident(cacheEntry* e) {
+    glDeleteTextures(1, &e->id);
+    e->id = 0;
+    if (e->palette)
+        glDeleteTextures(1, &e->palette);
+    e->palette = 0;
+}
+
+// width x height is the stored size at lod, data holds levels levels. palette only for PIXEL_INDEXED8
+static void makeResident(textureCache* cache, const size_t leader, const int width, const int height,
+                         const int levels, const int lod, const pixelLayout layout, const void* data, const unsigned char* palette) {
+    cacheEntry* e = &cache->entries[leader];
+    if (e->resident) {
+        // promoted to a finer level, the coarse copy was drawn until now
+        deleteResident(e);
+        cache->residentBytes -= e->bytes;
+        cache->resident--;
+        cache->promotions++;
+    } else {
+        cache->reloads++;
+    }
+
+    glGenTextures(1, &e->id);
+    uploadTexture(e->id, width, height, levels, layout, data);
+    e->bytes = pixelLayoutChainSize(layout, width, height, levels);
+    if (palette) {
+        glGenTextures(1, &e->palette);
+        uploadPalette(e->palette, palette);
+        e->bytes += PALETTE_BYTES;
+    }
+    e->levels = levels;
+    e->layout = layout;
+    e->lod = lod;
+    setGroup(cache, leader, e->id, true);
+
+    e->resident = true;
+    e->queued = false;
+    cache->residentBytes += e->bytes;
+    cache->resident++;
+}
+
+static void evict(textureCache* cache, const size_t leader) {
+    cacheEntry* e = &cache->entries[leader];
+    deleteResident(e);
+    setGroup(cache, leader, cache->placeholder, false);
+
+    e->resident = false;
+    cache->residentBytes -= e->bytes;
+    cache->resident--;
+    cache->evictions++;
+}
+
+textureCache* textureCacheCreate(texture* textures, const size_t count, const size_t budgetBytes, const size_t uploadBudget,
+                                 const texturePack* pack, const char** paths, const int decodeThreads, const unsigned decodeFlags) {
+    textureCache* cache = calloc(1, sizeof(textureCache));
+    cache->textures = textures;
+    cache->count = count;
+    cache->budgetBytes = budgetBytes;
+    cache->uploadBudget = uploadBudget;
+    cache->pack = pack;
+    cache->paths = paths;
+    cache->entries = malloc(sizeof(cacheEntry) * (count ? count : 1));
+    cache->packQueue = malloc(sizeof(size_t) * (count ? count : 1));
+    cache->candidates = malloc(sizeof(evictCandidate) * (count ? count : 1));
+
+    if (!pack) {
+        // reloads have to come out with the same stored size as the first load
+        cache->pool = decodePoolCreate(decodeThreads, decodeFlags & (DECODE_TRIM | DECODE_PREMULTIPLY | DECODE_NARROW | DECODE_LOSSY | DECODE_PALETTE));
+        if (!cache->pool) {
+            textureCacheDestroy(cache);
+            return nullptr;
+        }
+    }
+
+    static const unsigned char straight[4] = { 255, 255, 255, 64 };
+    static const unsigned char premultiplied[4] = { 64, 64, 64, 64 };
+    const bool premultiply = pack ? texturePackFlags(pack) & PACK_FLAG_PREMULTIPLIED : decodeFlags & DECODE_PREMULTIPLY;
+    glGenTextures(1, &cache->placeholder);
+    uploadTextureRGBA8(cache->placeholder, 1, 1, 1, premultiply ? premultiplied : straight);
+
+    for (size_t i = 0; i < count; ++i) {
+        const texture* tex = &textures[i];
+        cache->entries[i] = (cacheEntry){
+            .leader = i, .next = SIZE_MAX,
+            .id = tex->textureID,
+            .palette = tex->paletteID,
+            .levels = tex->levels,
+            .lod = tex->lod,
+            .layout = tex->layout,
+        };
+
+        // failed loads, atlas pages and arrays are left alone
+        if (!tex->ready || tex->atlasPage >= 0 || tex->arrayLayer >= 0)
+            continue;
+
+        size_t leader = i;
+        for (size_t j = 0; j < i && leader == i; ++j) {
+            if (cache->entries[j].managed && textures[j].textureID == tex->textureID)
+                leader = cache->entries[j].leader;
+        }
+
+        cache->entries[i].managed = true;
+        if (leader != i) {
+            cache->entries[i].leader = leader;
+            cache->entries[i].next = cache->entries[leader].next;
+            cache->entries[leader].next = i;
+            continue;
+        }
+
+        cache->entries[i].resident = true;
+        cache->entries[i].bytes = textureBytes(tex);
+        cache->residentBytes += cache->entries[i].bytes;
+        cache->resident++;
+        cache->managed++;
+    }
+    return cache;
+}
+
+void textureCacheDestroy(textureCache* cache) {
+    if (!cache)
+        return;
+    if (cache->pool) {
+        // let outstanding reloads finish so the workers can be joined
+        decodeResult res;
+        while (decodePoolPop(cache->pool, &res, true)) {
+            stbi_image_free(res.pixels);
+            free(res.palette);
+        }
+        decodePoolDestroy(cache->pool);
+    }
+    glDeleteTextures(1, &cache->placeholder);
+    free(cache->entries);
+    free(cache->packQueue);
+    free(cache->candidates);
+    free(cache);
+}
+
+void textureCacheSetReserved(textureCache* cache, const size_t bytes) {
+    if (bytes != cache->reservedBytes)
+        cache->warnedOverBudget = false;
+    cache->reservedBytes = bytes;
+}
+
+static int compareCandidates(const void* a, const void* b) {
+    const long la = ((const evictCandidate*)a)->lastUsed, lb = ((const evictCandidate*)b)->lastUsed;
+    return (la > lb) - (la < lb);
+}
+
+void textureCacheUpdate(textureCache* cache) {
+    size_t uploaded = 0;
+    const bool capped = cache->uploadBudget != 0;
+
+    decodeResult res;
+    while ((!capped || uploaded < cache->uploadBudget) && cache->pool && decodePoolPop(cache->pool, &res, false)) {
+        cacheEntry* e = &cache->entries[res.index];
+        if (!res.pixels) {
+            fprintf(stderr, "Failed to reload '%s': %s\n", res.path, res.failure);
+            // a failed promotion still has its coarse copy, which has to leave the budget with it
+            if (e->resident)
+                evict(cache, res.index);
+            e->queued = false;
+            e->managed = false;
+            cache->managed--;
+            continue;
+        }
+        makeResident(cache, res.index, res.width, res.height, 1, res.lod, res.layout, res.pixels, res.palette);
+        uploaded += e->bytes;
+        stbi_image_free(res.pixels);
+        free(res.palette);
+    }
+
+    size_t done = 0;
+    for (; done < cache->packQueued && (!capped || uploaded < cache->uploadBudget); ++done) {
+        const size_t leader = cache->packQueue[done];
+        const packEntry* pe = texturePackEntry(cache->pack, leader);
+        const int want = cache->entries[leader].wantLod;
+        const int skip = want < (int)pe->levels ? want : (int)pe->levels - 1;
+        makeResident(cache, leader, textureStoredSize((int)pe->width, skip), textureStoredSize((int)pe->height, skip),
+                     (int)pe->levels - skip, skip, packFormatLayout(pe->format), texturePackLevel(cache->pack, leader, (uint32_t)skip), nullptr);
+        uploaded += cache->entries[leader].bytes;
+    }
+    for (size_t i = done; i < cache->packQueued; ++i)
+        cache->packQueue[i - done] = cache->packQueue[i];
+    cache->packQueued -= done;
+
+    // anything drawn last frame is still in use, the rest goes oldest first
+    const size_t target = cache->reservedBytes < cache->budgetBytes ? cache->budgetBytes - cache->reservedBytes : 0;
+    if (cache->budgetBytes && cache->residentBytes > target) {
+        size_t candidatec = 0;
+        for (size_t i = 0; i < cache->count; ++i) {
+            const cacheEntry* e = &cache->entries[i];
+            if (e->managed && e->leader == i && e->resident && e->lastUsed < cache->frame)
+                cache->candidates[candidatec++] = (evictCandidate){ e->lastUsed, i };
+        }
+        qsort(cache->candidates, candidatec, sizeof(evictCandidate), compareCandidates);
+
+        for (size_t i = 0; i < candidatec && cache->residentBytes > target; ++i)
+            evict(cache, cache->candidates[i].leader);
+
+        if (cache->residentBytes > target && !cache->warnedOverBudget) {
+            fprintf(stderr, "Textures in use (%.1f MiB) do not fit the %.1f MiB VRAM budget next to %.1f MiB of render targets\n",
+                    cache->residentBytes / (1024.0 * 1024.0), cache->budgetBytes / (1024.0 * 1024.0),
+                    cache->reservedBytes / (1024.0 * 1024.0));
+            cache->warnedOverBudget = true;
+        }
+    }
+
+    cache->frame++;
+}
+
+void textureCacheTouch(textureCache* cache, const texture* tex, const int lod) {
+    const size_t index = (size_t)(tex - cache->textures);
+    if (index >= cache->count)
+        return;
+
+    const size_t leader = cache->entries[index].leader;
+    cacheEntry* e = &cache->entries[leader];
+    if (!e->managed)
+        return;
+    e->lastUsed = cache->frame;
+    if ((e->resident && e->lod <= lod) || e->queued)
+        return;
+
+    e->queued = true;
+    e->wantLod = lod;
+    if (cache->pack)
+        cache->packQueue[cache->packQueued++] = leader;
+    else
+        decodePoolSubmit(cache->pool, leader, cache->paths[leader], lod);
+}
+
+void textureCacheGetStats(const textureCache* cache, textureCacheStats* stats) {
+    *stats = (textureCacheStats){
+        .budgetBytes = cache->budgetBytes,
+        .reservedBytes = cache->reservedBytes,
+        .residentBytes = cache->residentBytes,
+        .resident = cache->resident,
+        .managed = cache->managed,
+        .evictions = cache->evictions,
+        .reloads = cache->reloads,
+        .promotions = cache->promotions,
+    };
+}
@@ -0,0 +1,50 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stddef.h>
+
+#include "texture.h"
+#include "texture_pack.h"
+
+// Keeps the sprite textures under a VRAM budget. Every texture drawn is touched
+// with the current frame, and when resident textures plus the reserved render
+// target memory go over the budget the least recently drawn ones are deleted.
+// An evicted texture points at a shared 1x1 placeholder (ready == false) and is
+// reloaded the next time it is touched: straight out of the pack mapping when
+// there is one, otherwise re-decoded from its PNG on a decodePool.
+// Textures sharing a GL name are evicted and reloaded together.
+// With scale-aware loading a texture stored at a coarser lod than a sprite now
+// needs is promoted the same way, the coarse copy is drawn until the finer one lands.
+
+typedef struct textureCache textureCache;
+
+typedef struct {
+    size_t budgetBytes;
+    size_t reservedBytes;
+    size_t residentBytes;
+    size_t resident, managed;
+    size_t evictions, reloads, promotions;
+} textureCacheStats;
+
+// textures must all be plain GL_TEXTURE_2D names (no atlas or arrays) and stay where they are.
+// pack may be nullptr, otherwise it is reloaded from and has to outlive the cache.
+// uploadBudget caps reload bytes per textureCacheUpdate, 0 for no cap.
+// budgetBytes == 0 never evicts, the cache then only handles promotion
+textureCache* textureCacheCreate(texture* textures, size_t count, size_t budgetBytes, size_t uploadBudget,
+                                 const texturePack* pack, const char** paths, int decodeThreads, unsigned decodeFlags);
+// deletes the placeholder, resident names stay with the texture array
+void textureCacheDestroy(textureCache* cache);
+
+// bytes held outside the cache that count against the budget, e.g. render targets
+void textureCacheSetReserved(textureCache* cache, size_t bytes);
+
+// once per frame before drawing: finishes reloads, evicts down to the budget and starts a new frame
+void textureCacheUpdate(textureCache* cache);
+
+// marks tex as drawn this frame and queues a reload when it is not resident,
+// or is resident at a coarser level than lod
+void textureCacheTouch(textureCache* cache, const texture* tex, int lod);
+
+void textureCacheGetStats(const textureCache* cache, textureCacheStats* stats);
+
+#endif //TEXTURE_CACHE_H
@@ -0,0 +1,271 @@
+// texture_pack.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "texture_pack.h"
+
+uint64_t texturePackHashPath(const char* path) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const unsigned char* c = (const unsigned char*)path; *c; ++c) {
+        hash ^= *c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+pixelLayout packFormatLayout(const uint32_t format) {
+    switch (format) {
+        case PACK_FORMAT_RGBA8: return PIXEL_RGBA8;
+        case PACK_FORMAT_BC3: return PIXEL_BC3;
+        case PACK_FORMAT_BC7: return PIXEL_BC7;
+        default: return PIXEL_LAYOUT_COUNT;
+    }
+}
+
+struct texturePackWriter {
+    FILE* file;
+    packEntry* entries;
+    size_t count;
+    uint32_t flags;
+    uint64_t offset;
+    bool failed;
+};
+
+texturePackWriter* texturePackWriterCreate(const char* path, const size_t count, const uint32_t flags) {
+    FILE* file = fopen(path, "w+b");
+    if (!file) {
+        fprintf(stderr, "Failed to create texture pack '%s'\n", path);
+        return nullptr;
+    }
+
+    texturePackWriter* writer = calloc(1, sizeof(texturePackWriter));
+    writer->file = file;
+    writer->count = count;
+    writer->flags = flags;
+    writer->entries = calloc(count, sizeof(packEntry));
+
+    // header and table are filled in at the end, reserve their space for now
+    const size_t tableSize = sizeof(packHeader) + sizeof(packEntry) * count;
+    void* zeros = calloc(1, tableSize);
+    writer->failed = fwrite(zeros, 1, tableSize, file) != tableSize;
+    writer->offset = tableSize;
+    free(zeros);
+
+    return writer;
+}
+
+bool texturePackWriterAdd(texturePackWriter* writer, const size_t index, const char* sourcePath,
+                          const packEntry* entry, const void* data) {
+    if (writer->failed || index >= writer->count)
+        return false;
+
+    static const unsigned char padding[PACK_ALIGN] = { 0 };
+    const size_t pad = (PACK_ALIGN - writer->offset % PACK_ALIGN) % PACK_ALIGN;
+    if (fwrite(padding, 1, pad, writer->file) != pad || fwrite(data, 1, entry->size, writer->file) != entry->size) {
+        writer->failed = true;
+        return false;
+    }
+    writer->offset += pad;
+
+    writer->entries[index] = *entry;
+    writer->entries[index].pathHash = texturePackHashPath(sourcePath);
+    writer->entries[index].offset = writer->offset;
+    writer->offset += entry->size;
+    return true;
+}
+
+bool texturePackWriterAlias(texturePackWriter* writer, const size_t index, const char* sourcePath,
+                            const packEntry* entry, const size_t sharedIndex) {
+    if (writer->failed || index >= writer->count || sharedIndex >= writer->count || !writer->entries[sharedIndex].offset)
+        return false;
+
+    writer->entries[index] = *entry;
+    writer->entries[index].pathHash = texturePackHashPath(sourcePath);
+    writer->entries[index].offset = writer->entries[sharedIndex].offset;
+    writer->entries[index].size = writer->entries[sharedIndex].size;
+    return true;
+}
+
+bool texturePackWriterRead(texturePackWriter* writer, const size_t index, void* out) {
+    if (writer->failed || index >= writer->count || !writer->entries[index].offset)
+        return false;
+    const packEntry* e = &writer->entries[index];
+    const bool ok = fseek(writer->file, (long)e->offset, SEEK_SET) == 0 && fread(out, 1, e->size, writer->file) == e->size;
+    // the next blob is appended, wherever this left the file position
+    writer->failed |= fseek(writer->file, 0, SEEK_END) != 0;
+    return ok;
+}
+
+bool texturePackWriterFinish(texturePackWriter* writer) {
+    const packHeader header = { PACK_MAGIC, PACK_VERSION, (uint32_t)writer->count, writer->flags };
+
+    bool ok = !writer->failed;
+    ok = ok && fseek(writer->file, 0, SEEK_SET) == 0;
+    ok = ok && fwrite(&header, sizeof(header), 1, writer->file) == 1;
+    ok = ok && fwrite(writer->entries, sizeof(packEntry), writer->count, writer->file) == writer->count;
+    ok = fclose(writer->file) == 0 && ok;
+
+    free(writer->entries);
+    free(writer);
+    return ok;
+}
+
+struct texturePack {
+    const unsigned char* base;
+    size_t size;
+    bool mapped; // false for texturePackOpenMemory, nothing to unmap
+    const packHeader* header;
+    const packEntry* entries;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+};
+
+static bool mapFile(texturePack* pack, const char* path) {
+#ifdef _WIN32
+    pack->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (pack->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(pack->file, &size);
+    pack->size = (size_t)size.QuadPart;
+
+    pack->mapping = CreateFileMappingA(pack->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!pack->mapping) {
+        CloseHandle(pack->file);
+        return false;
+    }
+    pack->base = MapViewOfFile(pack->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!pack->base) {
+        CloseHandle(pack->mapping);
+        CloseHandle(pack->file);
+        return false;
+    }
+    return true;
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    pack->size = (size_t)st.st_size;
+
+    void* base = mmap(nullptr, pack->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    // everything is about to be read front to back
+    madvise(base, pack->size, MADV_WILLNEED);
+    pack->base = base;
+    return true;
+#endif
+}
+
+static void unmapFile(texturePack* pack) {
+#ifdef _WIN32
+    UnmapViewOfFile(pack->base);
+    CloseHandle(pack->mapping);
+    CloseHandle(pack->file);
+#else
+    munmap((void*)pack->base, pack->size);
+#endif
+}
+
+static bool validatePack(texturePack* pack, const char* name) {
+    pack->header = (const packHeader*)pack->base;
+    pack->entries = (const packEntry*)(pack->base + sizeof(packHeader));
+
+    const char* problem = nullptr;
+    if (pack->size < sizeof(packHeader) || pack->header->magic != PACK_MAGIC)
+        problem = "not a texture pack";
+    else if (pack->header->version != PACK_VERSION)
+        problem = "unsupported version";
+    else if (sizeof(packHeader) + sizeof(packEntry) * (size_t)pack->header->count > pack->size)
+        problem = "truncated table";
+
+    for (size_t i = 0; !problem && i < pack->header->count; ++i) {
+        const packEntry* e = &pack->entries[i];
+        if (e->offset > pack->size || e->size > pack->size - e->offset)
+            problem = "entry out of bounds";
+    }
+
+    if (problem) {
+        fprintf(stderr, "Bad texture pack '%s': %s\n", name, problem);
+        return false;
+    }
+    return true;
+}
+
+texturePack* texturePackOpen(const char* path) {
+    texturePack* pack = calloc(1, sizeof(texturePack));
+    if (!mapFile(pack, path)) {
+        fprintf(stderr, "Failed to map texture pack '%s'\n", path);
+        free(pack);
+        return nullptr;
+    }
+    pack->mapped = true;
+
+    if (!validatePack(pack, path)) {
+        texturePackClose(pack);
+        return nullptr;
+    }
+    return pack;
+}
+
+texturePack* texturePackOpenMemory(const void* data, const size_t size, const char* name) {
+    texturePack* pack = calloc(1, sizeof(texturePack));
+    pack->base = data;
+    pack->size = size;
+    if (!validatePack(pack, name)) {
+        free(pack);
+        return nullptr;
+    }
+    return pack;
+}
+
+void texturePackClose(texturePack* pack) {
+    if (!pack)
+        return;
+    if (pack->mapped)
+        unmapFile(pack);
+    free(pack);
+}
+
+size_t texturePackCount(const texturePack* pack) {
+    return pack->header->count;
+}
+
+uint32_t texturePackFlags(const texturePack* pack) {
+    return pack->header->flags;
+}
+
+const packEntry* texturePackEntry(const texturePack* pack, const size_t index) {
+    return &pack->entries[index];
+}
+
+const void* texturePackData(const texturePack* pack, const size_t index) {
+    return pack->base + pack->entries[index].offset;
+}
+
+const void* texturePackLevel(const texturePack* pack, const size_t index, const uint32_t level) {
+    const packEntry* e = &pack->entries[index];
+    const unsigned char* data = pack->base + e->offset;
+    return data + pixelLayoutChainSize(packFormatLayout(e->format), (int)e->width, (int)e->height, (int)level);
+}
@@ -0,0 +1,83 @@
+#ifndef TEXTURE_PACK_H
+#define TEXTURE_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image_ops.h"
+
+// Pre-decoded texture pack. Layout (native little-endian):
+//   packHeader
+//   packEntry[count]     one per images[] entry, same order
+//   pixel data           each blob starts on a PACK_ALIGN boundary
+// The runtime maps the whole file and hands blob pointers straight to GL.
+// A blob holds the whole mip chain, level 0 first, levels packed back to back.
+// Entries with identical cooked pixels share one blob.
+
+#define PACK_MAGIC   0x4B415053u // "SPAK"
+#define PACK_VERSION 2u
+#define PACK_ALIGN   64u
+
+enum {
+    PACK_FORMAT_RGBA8 = 0,
+    PACK_FORMAT_BC3 = 1, // block_compress output, every level
+    PACK_FORMAT_BC7 = 2,
+};
+
+enum {
+    PACK_FLAG_PREMULTIPLIED = 1u << 0, // header flag, every blob has premultiplied alpha
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t flags;
+} packHeader;
+
+typedef struct {
+    uint64_t pathHash; // texturePackHashPath of the source path, to catch stale packs
+    uint64_t offset;   // from the start of the file
+    uint64_t size;
+    uint32_t width, height; // stored (trimmed) size of level 0
+    uint32_t format;
+    uint32_t levels;
+    uint32_t sourceWidth, sourceHeight; // size of the original image
+    uint32_t trimX, trimY; // where the stored rect sits inside the original
+} packEntry;
+
+uint64_t texturePackHashPath(const char* path);
+
+// PIXEL_LAYOUT_COUNT for formats this build doesn't know
+pixelLayout packFormatLayout(uint32_t format);
+
+typedef struct texturePackWriter texturePackWriter;
+
+// entries may be added in any order, the table is written on texturePackWriterFinish.
+// the caller fills everything in the entry except pathHash and offset
+texturePackWriter* texturePackWriterCreate(const char* path, size_t count, uint32_t flags);
+bool texturePackWriterAdd(texturePackWriter* writer, size_t index, const char* sourcePath,
+                          const packEntry* entry, const void* data);
+// points index at a blob already written for another entry
+bool texturePackWriterAlias(texturePackWriter* writer, size_t index, const char* sourcePath,
+                            const packEntry* entry, size_t sharedIndex);
+// reads back the blob written for index, entry size bytes
+bool texturePackWriterRead(texturePackWriter* writer, size_t index, void* out);
+bool texturePackWriterFinish(texturePackWriter* writer);
+
+typedef struct texturePack texturePack;
+
+texturePack* texturePackOpen(const char* path);
+// a pack already in memory (e.g. linked into the executable), which must outlive it.
+// name is only used in error messages
+texturePack* texturePackOpenMemory(const void* data, size_t size, const char* name);
+void texturePackClose(texturePack* pack);
+
+size_t texturePackCount(const texturePack* pack);
+uint32_t texturePackFlags(const texturePack* pack);
+const packEntry* texturePackEntry(const texturePack* pack, size_t index);
+const void* texturePackData(const texturePack* pack, size_t index);
+// start of mip level `level` inside the blob, level < levels
+const void* texturePackLevel(const texturePack* pack, size_t index, uint32_t level);
+
+#endif //TEXTURE_PACK_H
@@ -0,0 +1,399 @@
+// texture_stream.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "texture_stream.h"
+#include "decode_pool.h"
+#include "texture_upload.h"
+#include "staging_buffer.h"
+#include "stb_image.h"
+
+typedef struct {
+    uint64_t hash;
+    int width, height;
+    pixelLayout layout;
+    size_t index; // texture holding these pixels, SIZE_MAX for an empty slot
+} uploadedImage;
+
+typedef struct {
+    GLuint id; // 0 once the texture took it over (or a duplicate made it unnecessary)
+    int width, height;
+    pixelLayout layout;
+    bool allocated; // id has storage of the size and layout above
+} allocatedStorage;
+
+struct textureStream {
+    decodePool* pool;
+    texture* textures;
+    size_t count;
+    size_t remaining;
+    size_t failures;
+
+    bool dedup;
+    uploadedImage* uploaded; // open addressed on hash
+    size_t uploadedCap;
+    size_t duplicates;
+    size_t duplicateBytes;
+
+    GLuint pbo;
+    stagingBuffer* staging; // nullptr unless asked for and supported
+    size_t budgetBytes;
+
+    // every image gets its own name up front, and with a manifest storage at its predicted size
+    // and layout too, while the textures show one shared placeholder until their pixels arrive
+    allocatedStorage* storage;
+    GLuint placeholder;
+    bool manifest;
+    size_t predicted, mispredicted;
+
+    decodeResult* batch;
+    size_t batchCap;
+    decodeResult carry; // decoded but over last frame's budget
+    bool hasCarry;
+};
+
+static void releaseResult(textureStream* stream, decodeResult* r) {
+    if (r->staged)
+        stagingBufferRelease(stream->staging, r->stagingOffset, (size_t)r->width * r->height * pixelLayoutSize(r->layout));
+    else
+        stbi_image_free(r->pixels);
+    free(r->palette);
+}
+
+textureStream* textureStreamCreate(const char** paths, const size_t count, const int threadCount, const unsigned decodeFlags,
+                                   const size_t budgetBytes, const int* lods, const imageManifest* manifest,
+                                   const size_t stagingBytes) {
+    decodePool* pool = decodePoolCreate(threadCount, decodeFlags);
+    if (!pool)
+        return nullptr;
+
+    textureStream* stream = calloc(1, sizeof(textureStream));
+    stream->pool = pool;
+    stream->count = stream->remaining = count;
+    stream->budgetBytes = budgetBytes;
+    stream->textures = malloc(sizeof(texture) * count);
+    stream->manifest = manifest != nullptr;
+    if (stagingBytes) {
+        stream->staging = stagingBufferCreate(stagingBytes);
+        if (!stream->staging)
+            fprintf(stderr, "Persistent staging needs ARB_buffer_storage, uploading through a PBO instead\n");
+        decodePoolSetStaging(pool, stream->staging);
+    }
+
+    stream->dedup = decodeFlags & DECODE_HASH;
+    if (stream->dedup) {
+        stream->uploadedCap = 16;
+        while (stream->uploadedCap < count * 2)
+            stream->uploadedCap *= 2;
+        stream->uploaded = malloc(sizeof(uploadedImage) * stream->uploadedCap);
+        for (size_t i = 0; i < stream->uploadedCap; ++i)
+            stream->uploaded[i].index = SIZE_MAX;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        decodePoolSubmit(pool, i, paths[i], lods ? lods[i] : 0);
+
+    GLuint* ids = malloc(sizeof(GLuint) * count);
+    glGenTextures(count, ids);
+
+    static const unsigned char straight[4] = { 255, 255, 255, 64 };
+    static const unsigned char premultiplied[4] = { 64, 64, 64, 64 };
+    glGenTextures(1, &stream->placeholder);
+    uploadTextureRGBA8(stream->placeholder, 1, 1, 1, decodeFlags & DECODE_PREMULTIPLY ? premultiplied : straight);
+    stream->storage = calloc(count, sizeof(allocatedStorage));
+    for (size_t i = 0; i < count; ++i) {
+        // immutable storage can't take the real size later, so the placeholder is never put in these names
+        allocatedStorage* a = &stream->storage[i];
+        a->id = ids[i];
+        const manifestEntry* e = manifest ? imageManifestEntry(manifest, i) : nullptr;
+        if (!e) {
+            stream->textures[i] = makeTexture(PLACEHOLDER_SIZE, PLACEHOLDER_SIZE, stream->placeholder, false);
+            continue;
+        }
+
+        // sprites get their real size and trim rect right away, only the pixels are missing
+        decodePredict(e, decodeFlags, lods ? lods[i] : 0, &a->width, &a->height, &a->layout);
+        allocateTexture(a->id, a->width, a->height, 1, a->layout);
+        a->allocated = true;
+
+        const bool trim = decodeFlags & DECODE_TRIM;
+        stream->textures[i] = makeTrimmedTexture((int)e->width, (int)e->height, stream->placeholder, false,
+                                                 trim ? (int)e->trimX : 0, trim ? (int)e->trimY : 0,
+                                                 trim ? (int)e->trimWidth : (int)e->width, trim ? (int)e->trimHeight : (int)e->height);
+    }
+    free(ids);
+
+    glGenBuffers(1, &stream->pbo);
+    return stream;
+}
+
+void textureStreamDestroy(textureStream* stream) {
+    if (!stream)
+        return;
+
+    decodePoolDestroy(stream->pool);
+    if (stream->hasCarry)
+        releaseResult(stream, &stream->carry);
+
+    // storage never handed over, and the placeholder once nothing shows it any more
+    for (size_t i = 0; i < stream->count; ++i) {
+        if (stream->storage[i].id)
+            glDeleteTextures(1, &stream->storage[i].id);
+    }
+    bool placeholderShown = false;
+    for (size_t i = 0; i < stream->count; ++i)
+        placeholderShown |= stream->textures[i].textureID == stream->placeholder;
+    if (!placeholderShown)
+        glDeleteTextures(1, &stream->placeholder);
+    free(stream->storage);
+
+    glDeleteBuffers(1, &stream->pbo);
+    stagingBufferDestroy(stream->staging);
+    free(stream->uploaded);
+    free(stream->batch);
+    free(stream);
+}
+
+texture* textureStreamTextures(const textureStream* stream) {
+    return stream->textures;
+}
+
+bool textureStreamFinished(const textureStream* stream) {
+    return stream->remaining == 0;
+}
+
+size_t textureStreamFailures(const textureStream* stream) {
+    return stream->failures;
+}
+
+void textureStreamDuplicates(const textureStream* stream, size_t* count, size_t* bytes) {
+    *count = stream->duplicates;
+    *bytes = stream->duplicateBytes;
+}
+
+void textureStreamPredictions(const textureStream* stream, size_t* predicted, size_t* mispredicted) {
+    *predicted = stream->predicted;
+    *mispredicted = stream->mispredicted;
+}
+
+// the name texture index ends up with, even while it still shows a placeholder
+static GLuint finalTextureID(const textureStream* stream, const size_t index) {
+    if (stream->storage[index].id)
+        return stream->storage[index].id;
+    return stream->textures[index].textureID;
+}
+
+// bytes of r's pixels, where the CPU may read them. staged pixels sit in a write-only mapping,
+// so GL copies those out into scratch
+static const unsigned char* readablePixels(const textureStream* stream, const decodeResult* r, const size_t bytes,
+                                           unsigned char* scratch) {
+    if (!r->staged)
+        return r->pixels;
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBufferName(stream->staging));
+    glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)r->stagingOffset, (GLsizeiptr)bytes, scratch);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return scratch;
+}
+
+// equal hashes only make equal pixels likely, so before r aliases original the pixels are compared.
+// original's are either still waiting in this batch or read back from its texture
+static bool samePixels(const textureStream* stream, const size_t batchc, const size_t original, const decodeResult* r) {
+    const size_t bytes = (size_t)r->width * r->height * pixelLayoutSize(r->layout);
+    unsigned char* scratch = malloc(bytes * 2 + PALETTE_BYTES);
+    const unsigned char* pixels = readablePixels(stream, r, bytes, scratch);
+
+    const decodeResult* pending = nullptr;
+    for (size_t i = 0; i < batchc && !pending; ++i) {
+        if (stream->batch[i].index == original)
+            pending = &stream->batch[i];
+    }
+
+    bool same;
+    const unsigned char* palette = nullptr;
+    if (pending) {
+        same = memcmp(readablePixels(stream, pending, bytes, scratch + bytes), pixels, bytes) == 0;
+        palette = pending->palette;
+    } else {
+        same = downloadTexture(finalTextureID(stream, original), r->width, r->height, r->layout, scratch + bytes) &&
+               memcmp(scratch + bytes, pixels, bytes) == 0;
+        if (same && r->palette && downloadTexture(stream->textures[original].paletteID, PALETTE_BYTES / 4, 1, PIXEL_RGBA8,
+                                                  scratch + bytes * 2))
+            palette = scratch + bytes * 2;
+    }
+    if (r->palette)
+        same = same && palette && memcmp(palette, r->palette, PALETTE_BYTES) == 0;
+    free(scratch);
+    return same;
+}
+
+// index of the texture already holding the same pixels, or SIZE_MAX after claiming the slot for r
+static size_t findOrAddUploaded(textureStream* stream, const decodeResult* r, const size_t batchc) {
+    size_t slot = r->hash & (stream->uploadedCap - 1);
+    for (;; slot = (slot + 1) & (stream->uploadedCap - 1)) {
+        uploadedImage* img = &stream->uploaded[slot];
+        if (img->index == SIZE_MAX) {
+            *img = (uploadedImage){ r->hash, r->width, r->height, r->layout, r->index };
+            return SIZE_MAX;
+        }
+        // a hash collision keeps probing, and gets a slot of its own
+        if (img->hash == r->hash && img->width == r->width && img->height == r->height && img->layout == r->layout &&
+            (img->index == r->index || samePixels(stream, batchc, img->index, r)))
+            return img->index;
+    }
+}
+
+// bytes a result takes in the PBO, padded so every upload starts 4 byte aligned
+static size_t stagedSize(const decodeResult* r) {
+    return ((size_t)r->width * r->height * pixelLayoutSize(r->layout) + 3) & ~(size_t)3;
+}
+
+static bool nextResult(textureStream* stream, decodeResult* out, const bool wait) {
+    if (stream->hasCarry) {
+        *out = stream->carry;
+        stream->hasCarry = false;
+        return true;
+    }
+    return decodePoolPop(stream->pool, out, wait);
+}
+
+size_t textureStreamUpdate(textureStream* stream, const bool wait) {
+    if (stream->remaining == 0)
+        return 0;
+
+    // gather this frame's images. the first one is always taken, even if it alone is over budget
+    size_t batchc = 0;
+    size_t bytes = 0;
+    decodeResult res;
+    while (nextResult(stream, &res, wait && batchc == 0)) {
+        if (!res.pixels) {
+            fprintf(stderr, "Failed to load '%s': %s\n", res.path, res.failure);
+            stream->failures++;
+            stream->remaining--;
+            continue;
+        }
+
+        const size_t size = stagedSize(&res);
+        if (stream->dedup) {
+            const size_t original = findOrAddUploaded(stream, &res, batchc);
+            if (original != SIZE_MAX && original != res.index) {
+                // the original may still be waiting in this batch, its name is valid either way
+                texture* tex = &stream->textures[res.index];
+                glDeleteTextures(1, &stream->storage[res.index].id);
+                stream->storage[res.index].id = 0;
+                *tex = makeTrimmedTexture(res.sourceWidth, res.sourceHeight, finalTextureID(stream, original), true,
+                                          res.trimX, res.trimY, res.trimWidth, res.trimHeight);
+                tex->lod = res.lod;
+                tex->layout = res.layout;
+                tex->paletteID = stream->textures[original].paletteID;
+                stream->duplicates++;
+                stream->duplicateBytes += size;
+                stream->remaining--;
+                releaseResult(stream, &res);
+                continue;
+            }
+        }
+
+        // storage of the wrong size is respecified on upload, but immutable storage can't be, so that
+        // texture moves to a fresh name now, before any duplicate later in the batch takes the old one
+        allocatedStorage* a = &stream->storage[res.index];
+        if (a->allocated && (a->width != res.width || a->height != res.height || a->layout != res.layout)) {
+            if (textureUploadImmutable()) {
+                glDeleteTextures(1, &a->id);
+                glGenTextures(1, &a->id);
+            }
+            a->allocated = false;
+        }
+
+        // palettes are tiny and go up right away, so duplicates found later can share the name
+        if (res.palette && !stream->textures[res.index].paletteID) {
+            glGenTextures(1, &stream->textures[res.index].paletteID);
+            uploadPalette(stream->textures[res.index].paletteID, res.palette);
+        }
+
+        if (stream->budgetBytes && batchc > 0 && bytes + size > stream->budgetBytes) {
+            stream->carry = res;
+            stream->hasCarry = true;
+            break;
+        }
+
+        if (batchc == stream->batchCap) {
+            stream->batchCap = stream->batchCap ? stream->batchCap * 2 : 16;
+            stream->batch = realloc(stream->batch, sizeof(decodeResult) * stream->batchCap);
+        }
+        stream->batch[batchc++] = res;
+        bytes += size;
+    }
+
+    if (batchc == 0)
+        return 0;
+
+    // staged images are already in GPU visible memory, the rest go through the orphaned PBO
+    size_t pboBytes = 0;
+    for (size_t i = 0; i < batchc; ++i)
+        pboBytes += stream->batch[i].staged ? 0 : stagedSize(&stream->batch[i]);
+
+    // orphan the PBO so the driver never has to wait on last frame's transfers
+    unsigned char* mapped = nullptr;
+    if (pboBytes) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pboBytes, nullptr, GL_STREAM_DRAW);
+        mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pboBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+        size_t offset = 0;
+        for (size_t i = 0; i < batchc && mapped; ++i) {
+            const decodeResult* r = &stream->batch[i];
+            if (r->staged)
+                continue;
+            memcpy(mapped + offset, r->pixels, (size_t)r->width * r->height * pixelLayoutSize(r->layout));
+            offset += stagedSize(r);
+        }
+        // on failure, fall back to plain client memory uploads
+        if (mapped && !glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+            mapped = nullptr;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < batchc; ++i) {
+        decodeResult* r = &stream->batch[i];
+        texture* tex = &stream->textures[r->index];
+
+        const void* data;
+        if (r->staged) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBufferName(stream->staging));
+            data = (const void*)r->stagingOffset;
+        } else if (mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->pbo);
+            data = (const void*)offset;
+            offset += stagedSize(r);
+        } else {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            data = r->pixels;
+        }
+
+        allocatedStorage* a = &stream->storage[r->index];
+        const GLuint id = a->id;
+        if (a->allocated) {
+            updateTexture(id, r->width, r->height, r->layout, data);
+            stream->predicted++;
+        } else {
+            uploadTexture(id, r->width, r->height, 1, r->layout, data);
+            stream->mispredicted += stream->manifest;
+        }
+        a->id = 0;
+
+        const GLuint palette = tex->paletteID;
+        *tex = makeTrimmedTexture(r->sourceWidth, r->sourceHeight, id, true, r->trimX, r->trimY, r->trimWidth, r->trimHeight);
+        tex->lod = r->lod;
+        tex->layout = r->layout;
+        tex->paletteID = palette;
+
+        releaseResult(stream, r);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (stream->staging)
+        stagingBufferFence(stream->staging);
+
+    stream->remaining -= batchc;
+    return batchc;
+}
@@ -0,0 +1,47 @@
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+#include <stddef.h>
+
+#include "texture.h"
+#include "image_manifest.h"
+
+// Asynchronous texture loading. textureStreamCreate hands back usable texture
+// handles straight away (each one holding a placeholder) while a decodePool works
+// through the files. textureStreamUpdate is called once per frame on the GL thread
+// and uploads finished images through a pixel buffer object, at most budgetBytes
+// of pixel data per call so a frame never stalls on a burst of uploads.
+
+#define PLACEHOLDER_SIZE 64
+
+typedef struct textureStream textureStream;
+
+// budgetBytes == 0 uploads everything that is ready on each update
+// decodeFlags are passed on to the decodePool. lods may be nullptr, otherwise
+// image i is stored lods[i] levels down from full size, see texture.lod.
+// with a manifest (may be nullptr) each texture's storage is allocated before decoding,
+// see decodePredict, and textures carry their real size while they wait.
+// stagingBytes > 0 has decode threads copy finished images into a persistently mapped
+// buffer of that size (see stagingBuffer), so they skip the copy into the PBO
+textureStream* textureStreamCreate(const char** paths, size_t count, int threadCount, unsigned decodeFlags,
+                                   size_t budgetBytes, const int* lods, const imageManifest* manifest,
+                                   size_t stagingBytes);
+void textureStreamDestroy(textureStream* stream);
+
+// the array belongs to the caller and stays valid after textureStreamDestroy
+texture* textureStreamTextures(const textureStream* stream);
+
+// with wait set, blocks until at least one image is decoded. returns the number uploaded
+size_t textureStreamUpdate(textureStream* stream, bool wait);
+
+bool textureStreamFinished(const textureStream* stream);
+size_t textureStreamFailures(const textureStream* stream);
+
+// with DECODE_HASH, images whose pixels match one already uploaded share its GL texture
+// instead of getting their own. counts what that skipped so far
+void textureStreamDuplicates(const textureStream* stream, size_t* count, size_t* bytes);
+
+// with a manifest: uploads that filled their preallocated storage, and those that had to respecify it
+void textureStreamPredictions(const textureStream* stream, size_t* predicted, size_t* mispredicted);
+
+#endif //TEXTURE_STREAM_H
@@ -0,0 +1,178 @@
+// texture_upload.c
+#include <stddef.h>
+
+#include "texture_upload.h"
+
+typedef struct {
+    GLint internalFormat;
+    GLenum format, type;
+    GLint swizzle[4];
+} layoutFormat;
+
+static const layoutFormat layoutFormats[PIXEL_LAYOUT_COUNT] = {
+    [PIXEL_RGBA8] = { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } },
+    [PIXEL_RGB8] = { GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, { GL_RED, GL_GREEN, GL_BLUE, GL_ONE } },
+    [PIXEL_RGB565] = { GL_RGB565, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, { GL_RED, GL_GREEN, GL_BLUE, GL_ONE } },
+    [PIXEL_GRAY_ALPHA] = { GL_RG8, GL_RG, GL_UNSIGNED_BYTE, { GL_RED, GL_RED, GL_RED, GL_GREEN } },
+    [PIXEL_GRAY] = { GL_R8, GL_RED, GL_UNSIGNED_BYTE, { GL_RED, GL_RED, GL_RED, GL_ONE } },
+    [PIXEL_ALPHA_BLACK] = { GL_R8, GL_RED, GL_UNSIGNED_BYTE, { GL_ZERO, GL_ZERO, GL_ZERO, GL_RED } },
+    [PIXEL_ALPHA_WHITE] = { GL_R8, GL_RED, GL_UNSIGNED_BYTE, { GL_ONE, GL_ONE, GL_ONE, GL_RED } },
+    [PIXEL_ALPHA_WHITE_PREMULTIPLIED] = { GL_R8, GL_RED, GL_UNSIGNED_BYTE, { GL_RED, GL_RED, GL_RED, GL_RED } },
+    [PIXEL_INDEXED8] = { GL_R8, GL_RED, GL_UNSIGNED_BYTE, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } },
+    [PIXEL_BC3] = { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } },
+    [PIXEL_BC7] = { GL_COMPRESSED_RGBA_BPTC_UNORM_ARB, 0, 0, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } },
+};
+
+// glTexStorage2D once the driver has it, see textureUploadSetImmutable
+static bool Immutable;
+
+bool textureLayoutSupported(const pixelLayout layout) {
+    switch (layout) {
+        case PIXEL_BC3: return GLAD_GL_EXT_texture_compression_s3tc;
+        case PIXEL_BC7: return GLAD_GL_ARB_texture_compression_bptc;
+        default: return layout < PIXEL_LAYOUT_COUNT;
+    }
+}
+
+bool textureUploadSetImmutable(const bool immutable) {
+    Immutable = immutable && GLAD_GL_ARB_texture_storage;
+    return Immutable;
+}
+
+bool textureUploadImmutable(void) {
+    return Immutable;
+}
+
+static void setSampling(const GLuint id, const int levels, const pixelLayout layout) {
+    // indices don't filter, the indexed shader fetches and blends the colours itself
+    const bool indexed = layout == PIXEL_INDEXED8;
+
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, indexed ? GL_NEAREST : levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, indexed ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, layoutFormats[layout].swizzle);
+}
+
+// one level of the bound texture, which already has storage for it
+static void subImage(const int level, const int width, const int height, const pixelLayout layout, const void* data) {
+    const layoutFormat* f = &layoutFormats[layout];
+    if (pixelLayoutCompressed(layout))
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, (GLenum)f->internalFormat,
+                                  (GLsizei)pixelLayoutLevelSize(layout, width, height), data);
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, f->format, f->type, data);
+}
+
+// mutable storage for every level, filled from data (or left undefined with nullptr and no unpack buffer)
+static void specifyLevels(int width, int height, const int levels, const pixelLayout layout, const void* data) {
+    const layoutFormat* f = &layoutFormats[layout];
+    const bool compressed = pixelLayoutCompressed(layout);
+    const unsigned char* level = data;
+    for (int i = 0; i < levels; ++i) {
+        const size_t size = pixelLayoutLevelSize(layout, width, height);
+        if (compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, (GLenum)f->internalFormat, width, height, 0, (GLsizei)size, level);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, f->internalFormat, width, height, 0, f->format, f->type, level);
+        level += size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+
+void allocateTexture(const GLuint id, const int width, const int height, const int levels, const pixelLayout layout) {
+    setSampling(id, levels, layout);
+    if (Immutable) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, (GLenum)layoutFormats[layout].internalFormat, width, height);
+        return;
+    }
+
+    // nullptr must not be read as an offset into whatever unpack buffer is bound
+    GLint unpack = 0;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack);
+    if (unpack)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    specifyLevels(width, height, levels, layout, nullptr);
+    if (unpack)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)unpack);
+}
+
+void uploadTexture(const GLuint id, int width, int height, const int levels, const pixelLayout layout, const void* data) {
+    const int pixelSize = pixelLayoutSize(layout);
+
+    // rows of the narrow layouts are tightly packed, not 4 byte aligned
+    if (pixelSize != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (Immutable) {
+        allocateTexture(id, width, height, levels, layout);
+        const unsigned char* level = data;
+        for (int i = 0; i < levels; ++i) {
+            subImage(i, width, height, layout, level);
+            level += pixelLayoutLevelSize(layout, width, height);
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+    } else {
+        setSampling(id, levels, layout);
+        specifyLevels(width, height, levels, layout, data);
+    }
+
+    if (pixelSize != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void updateTexture(const GLuint id, const int width, const int height, const pixelLayout layout, const void* data) {
+    const int pixelSize = pixelLayoutSize(layout);
+
+    glBindTexture(GL_TEXTURE_2D, id);
+    if (pixelSize != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    subImage(0, width, height, layout, data);
+    if (pixelSize != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+bool downloadTexture(const GLuint id, const int width, const int height, const pixelLayout layout, void* out) {
+    const layoutFormat* f = &layoutFormats[layout];
+    const int pixelSize = pixelLayoutSize(layout);
+
+    // glGetTexImage writes the whole level, whatever size out is
+    GLint levelWidth = 0, levelHeight = 0, internalFormat = 0;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &levelWidth);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &levelHeight);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    if (levelWidth != width || levelHeight != height || internalFormat != f->internalFormat)
+        return false;
+
+    GLint pack = 0;
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack);
+    if (pack)
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (pixelSize != 4)
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (pixelLayoutCompressed(layout))
+        glGetCompressedTexImage(GL_TEXTURE_2D, 0, out);
+    else
+        glGetTexImage(GL_TEXTURE_2D, 0, f->format, f->type, out);
+    if (pixelSize != 4)
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    if (pack)
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, (GLuint)pack);
+    return true;
+}
+
+void uploadPalette(const GLuint id, const unsigned char* palette) {
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    if (Immutable) {
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, PALETTE_BYTES / 4, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PALETTE_BYTES / 4, 1, GL_RGBA, GL_UNSIGNED_BYTE, palette);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, PALETTE_BYTES / 4, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, palette);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <glad/glad.h>
+
+#include "image_ops.h"
+
+// Every path that puts sprite pixels on the GPU goes through here so they all
+// end up with the same storage and sampling state.
+
+// block layouts need their GL extension, everything else is core 3.3
+bool textureLayoutSupported(pixelLayout layout);
+
+// immutable storage (glTexStorage2D, ARB_texture_storage) for everything allocated from now on.
+// returns whether it is in use, false when the driver lacks it. once a name has immutable
+// storage it can only be filled, never given another size, so callers allocate fresh names
+bool textureUploadSetImmutable(bool immutable);
+bool textureUploadImmutable(void);
+
+// storage and sampling state for all levels of a fresh name, contents undefined
+void allocateTexture(GLuint id, int width, int height, int levels, pixelLayout layout);
+
+// allocates all levels of a fresh (or mutable) name and fills them from levels stored back to back,
+// level 0 first, each tightly packed in layout (whole blocks for BC3/BC7). narrow layouts get a swizzle
+// so shaders still see RGBA. data may be an offset into the currently bound GL_PIXEL_UNPACK_BUFFER
+void uploadTexture(GLuint id, int width, int height, int levels, pixelLayout layout, const void* data);
+
+// fills level 0 of storage an earlier uploadTexture gave exactly this size and layout, without
+// respecifying it. data may be a pixel unpack buffer offset like for uploadTexture
+void updateTexture(GLuint id, int width, int height, pixelLayout layout, const void* data);
+
+// reads level 0 back into out, pixelLayoutLevelSize bytes, tightly packed in layout. false, with out
+// untouched, if level 0 isn't that size and layout. waits for the GPU, so only for rare checks
+bool downloadTexture(GLuint id, int width, int height, pixelLayout layout, void* out);
+
+// the colours of a PIXEL_INDEXED8 texture, sampled by index with texelFetch
+void uploadPalette(GLuint id, const unsigned char* palette);
+
+static inline void uploadTextureRGBA8(const GLuint id, const int width, const int height, const int levels, const void* data) {
+    uploadTexture(id, width, height, levels, PIXEL_RGBA8, data);
+}
+
+#endif //TEXTURE_UPLOAD_H